@@ -0,0 +1,445 @@
+// 64 bit file offsets so multi-GB carriers and payloads work
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include "analyze.h"
+#include "carrier_cache.h"
+#include "io_engine.h"
+#include "mem_pool.h"
+#include "types.h"
+
+/* Function Definitions */
+
+/* Read and validate analyze arguments
+ * Input: Command line arguments and anaInfo
+ * Output: File name and region size are stored in anaInfo
+ * Return: e_success or e_failure
+ */
+Status read_and_validate_analyze_args(char *argv[], AnalyzeInfo *anaInfo)
+{
+    memset(anaInfo, 0, sizeof(*anaInfo));
+    // Checks if 2nd argument passed is a carrier image file, .bmp, .ppm, .pgm or .tga
+    if (carrier_format_by_name(argv[2]) != NULL)
+    {
+        // stores it in anaInfo
+        anaInfo->image_fname = argv[2];
+    }
+    else
+    {
+        printf("INFO : Please mention image file correctly Eg:stego.bmp\n");
+        return e_failure;
+    }
+    // checks if region size in KB is provided or not
+    if (argv[3] != NULL)
+    {
+        int region_kb = atoi(argv[3]);
+        // upto 1 GB, histogram banks count one I/O block at a time so they can not overflow
+        if (region_kb <= 0 || region_kb > (1 << 20))
+        {
+            printf("INFO : Please mention region size in KB correctly Eg:1024\n");
+            return e_failure;
+        }
+        anaInfo->region_size = (uint64_t)region_kb * 1024;
+    }
+    else
+    {
+        anaInfo->region_size = (uint64_t)ANALYZE_DEFAULT_REGION_KB * 1024;
+    }
+    // checks if placement policy is provided or not
+    anaInfo->placement = e_place_node;
+    if (argv[3] != NULL && argv[4] != NULL && placement_parse_policy(argv[4], &anaInfo->placement) != e_success)
+    {
+        printf("INFO : Please mention placement policy correctly Eg:none, node or core\n");
+        return e_failure;
+    }
+    return e_success;
+}
+
+/* Read image header fields needed for analysis
+ * Input: anaInfo with image file opened
+ * Output: Pixel span offset, size and bytes per pixel are stored in anaInfo
+ * Description: Header is parsed by the carrier format, taken from the carrier cache
+ * Return: e_success or e_failure
+ */
+Status read_analyze_header(AnalyzeInfo *anaInfo)
+{
+    CarrierInfo carrier;
+    if (carrier_cache_get(anaInfo->fptr_image, &carrier) != e_success)
+        return e_failure;
+    if (carrier.bits_per_pixel < 8)
+        return e_failure;
+    anaInfo->pixel_offset = carrier.pixel_offset;
+    anaInfo->pixel_size = carrier.pixel_end - carrier.pixel_offset;
+    anaInfo->bytes_per_pixel = carrier.bits_per_pixel / 8;
+    return e_success;
+}
+
+/* Count byte values
+ * Inputs: Data, size and histogram of 256 counters
+ * Output: Counts are added to histogram
+ * Description: Four banks of counters are used so consecutive bytes with the
+ * same value do not wait on each other's increment. Lanes of a vector would
+ * increment conflicting counters, so the loop is kept scalar
+ */
+void histogram_bytes(const unsigned char *data, size_t size, uint64_t *histogram)
+{
+    uint32_t bank[4][256];
+    memset(bank, 0, sizeof(bank));
+    size_t i = 0;
+    for (; i + 4 <= size; i += 4)
+    {
+        bank[0][data[i]]++;
+        bank[1][data[i + 1]]++;
+        bank[2][data[i + 2]]++;
+        bank[3][data[i + 3]]++;
+    }
+    for (; i < size; i++)
+        bank[0][data[i]]++;
+    for (uint v = 0; v < 256; v++)
+        histogram[v] += (uint64_t)bank[0][v] + bank[1][v] + bank[2][v] + bank[3][v];
+}
+
+/* Negative flip F-1
+ * Input: Pixel value
+ * Output: 2k - 1 and 2k are swapped, 0 and 255 have no partner in 0..255
+ * so they are kept
+ * Return Value: Flipped value
+ */
+static inline int rs_flip_negative(int x)
+{
+    int y = ((x + 1) ^ 1) - 1;
+    return y < 0 || y > 255 ? x : y;
+}
+
+/* Count RS groups
+ * Inputs: Data, size, bytes per pixel and RS counters
+ * Output: Regular and singular groups under masks M and -M, for the data and
+ * for the data with every LSB flipped, are added to the counters
+ * Description: A group is 4 neighbouring pixels of one channel, its smoothness
+ * is the sum of absolute differences. M flips LSB of the middle pixels (F1),
+ * -M shifts them by one and flips (F-1). Groups with a 0 or 255 pixel are skipped
+ */
+void rs_count_groups(const unsigned char *data, size_t size, uint bytes_per_pixel, uint64_t *rs)
+{
+    size_t group_bytes = ANALYZE_GROUP_PIXELS * bytes_per_pixel;
+    uint64_t count[e_rs_counters];
+    memset(count, 0, sizeof(count));
+    for (size_t g = 0; g + group_bytes <= size; g += group_bytes)
+    {
+        for (uint c = 0; c < bytes_per_pixel; c++)
+        {
+            const unsigned char *p = data + g + c;
+            int x0 = p[0], x1 = p[bytes_per_pixel], x2 = p[2 * bytes_per_pixel], x3 = p[3 * bytes_per_pixel];
+            // F1 and F-1 are not symmetric at 0 and 255, saturated groups bias the counts
+            if (x0 == 0 || x0 == 255 || x1 == 0 || x1 == 255 || x2 == 0 || x2 == 255 || x3 == 0 || x3 == 255)
+                continue;
+            int f = abs(x1 - x0) + abs(x2 - x1) + abs(x3 - x2);
+            int m1 = x1 ^ 1, m2 = x2 ^ 1;
+            int fm = abs(m1 - x0) + abs(m2 - m1) + abs(x3 - m2);
+            int n1 = rs_flip_negative(x1), n2 = rs_flip_negative(x2);
+            int fn = abs(n1 - x0) + abs(n2 - n1) + abs(x3 - n2);
+            count[e_rs_regular_m] += fm > f;
+            count[e_rs_singular_m] += fm < f;
+            count[e_rs_regular_n] += fn > f;
+            count[e_rs_singular_n] += fn < f;
+
+            // same group with every LSB flipped, M on it restores the middle pixels
+            int y0 = x0 ^ 1, y1 = x1 ^ 1, y2 = x2 ^ 1, y3 = x3 ^ 1;
+            int fy = abs(y1 - y0) + abs(y2 - y1) + abs(y3 - y2);
+            int fym = abs(x1 - y0) + abs(x2 - x1) + abs(y3 - x2);
+            int yn1 = rs_flip_negative(y1), yn2 = rs_flip_negative(y2);
+            int fyn = abs(yn1 - y0) + abs(yn2 - yn1) + abs(y3 - yn2);
+            count[e_rs_flipped_regular_m] += fym > fy;
+            count[e_rs_flipped_singular_m] += fym < fy;
+            count[e_rs_flipped_regular_n] += fyn > fy;
+            count[e_rs_flipped_singular_n] += fyn < fy;
+        }
+    }
+    for (uint i = 0; i < e_rs_counters; i++)
+        rs[i] += count[i];
+}
+
+/* Regularized upper incomplete gamma function Q(a, x)
+ * Inputs: a and x
+ * Return Value: Q(a, x), by series for x < a + 1, else by continued fraction
+ */
+static double gamma_q(double a, double x)
+{
+    if (x <= 0)
+        return 1.0;
+    double prefix = exp(-x + a * log(x) - lgamma(a));
+    if (x < a + 1)
+    {
+        double ap = a, del = 1.0 / a, sum = del;
+        for (int n = 0; n < 10000 && fabs(del) >= fabs(sum) * 1e-12; n++)
+        {
+            ap += 1;
+            del *= x / ap;
+            sum += del;
+        }
+        return 1.0 - sum * prefix;
+    }
+    // modified Lentz method
+    double b = x + 1 - a, c = 1e300, d = 1.0 / b, h = d;
+    for (int i = 1; i < 10000; i++)
+    {
+        double an = -i * (i - a);
+        b += 2;
+        d = an * d + b;
+        if (fabs(d) < 1e-300)
+            d = 1e-300;
+        c = b + an / c;
+        if (fabs(c) < 1e-300)
+            c = 1e-300;
+        d = 1.0 / d;
+        double del = d * c;
+        h *= del;
+        if (fabs(del - 1.0) < 1e-12)
+            break;
+    }
+    return prefix * h;
+}
+
+/* Chi-square probability of LSB embedding
+ * Input: Histogram of 256 counters
+ * Description: LSB embedding equalises counts of each pair of values (2k, 2k+1).
+ * Chi-square of the even counts against the pair means is small then, so the
+ * upper tail probability is close to 1. Pairs with few samples are skipped
+ * Return Value: Probability in 0..1
+ */
+double chi_square_probability(const uint64_t *histogram)
+{
+    double chi = 0;
+    uint categories = 0;
+    for (uint k = 0; k < 128; k++)
+    {
+        double expected = (histogram[2 * k] + histogram[2 * k + 1]) / 2.0;
+        if (expected < ANALYZE_CHI_MIN_EXPECTED)
+            continue;
+        double diff = histogram[2 * k] - expected;
+        chi += diff * diff / expected;
+        categories++;
+    }
+    if (categories < 2)
+        return 0;
+    return gamma_q((categories - 1) / 2.0, chi / 2.0);
+}
+
+/* RS estimate of embedded message length
+ * Input: RS counters
+ * Description: Solves 2(d1 + d0)z^2 + (d-0 - d-1 - d1 - 3d0)z + d0 - d-0 = 0
+ * where d is regular minus singular under M (d0) and -M (d-0), and the same on
+ * the flipped data (d1, d-1), then p = z / (z - 1/2). Flat or saturated data
+ * gives no real root, or a root far from 0 which would read as full embedding,
+ * so only roots in [-0.5, 0.5] count
+ * Return Value: Fraction of pixels carrying a message, in 0..1, or
+ * ANALYZE_NO_ESTIMATE
+ */
+double rs_estimate(const uint64_t *rs)
+{
+    // counts are relative to the number of groups so thresholds do not depend on size
+    double groups = (double)rs[e_rs_regular_m] + rs[e_rs_singular_m] + 1;
+    double d0 = ((double)rs[e_rs_regular_m] - rs[e_rs_singular_m]) / groups;
+    double dn0 = ((double)rs[e_rs_regular_n] - rs[e_rs_singular_n]) / groups;
+    double d1 = ((double)rs[e_rs_flipped_regular_m] - rs[e_rs_flipped_singular_m]) / groups;
+    double dn1 = ((double)rs[e_rs_flipped_regular_n] - rs[e_rs_flipped_singular_n]) / groups;
+    double a = 2 * (d1 + d0), b = dn0 - dn1 - d1 - 3 * d0, c = d0 - dn0;
+    double z;
+    if (fabs(a) < 1e-9)
+    {
+        if (fabs(b) < 1e-9)
+            return ANALYZE_NO_ESTIMATE;
+        z = -c / b;
+    }
+    else
+    {
+        double disc = b * b - 4 * a * c;
+        if (disc < 0)
+            return ANALYZE_NO_ESTIMATE;
+        // root with the smaller magnitude
+        double z1 = (-b + sqrt(disc)) / (2 * a), z2 = (-b - sqrt(disc)) / (2 * a);
+        z = fabs(z1) < fabs(z2) ? z1 : z2;
+    }
+    if (z < -0.5 || z > 0.5)
+        return ANALYZE_NO_ESTIMATE;
+    // roots above 0 mean a negative length, clamped to none
+    if (z > 0)
+        return 0;
+    double p = z / (z - 0.5);
+    return p < 0 ? 0 : p > 1 ? 1 : p;
+}
+
+/* Format an RS estimate
+ * Inputs: Estimate and text buffer of at least 16 bytes
+ * Return Value: Text, "none" if there is no estimate
+ */
+static const char *rs_estimate_text(double rs_p, char *text)
+{
+    if (rs_p == ANALYZE_NO_ESTIMATE)
+        return "none";
+    sprintf(text, "%.3f", rs_p);
+    return text;
+}
+
+/* Analyse one region
+ * Inputs: anaInfo, region index and id of the worker running it
+ * Output: Histogram and RS counters of the region are stored in anaInfo,
+ * region is read once in blocks from the shared block pool
+ */
+void analyze_region(void *arg, long region, uint worker_id)
+{
+    AnalyzeInfo *anaInfo = arg;
+    RegionStats *stats = &anaInfo->regions[region];
+    int fd = fileno(anaInfo->fptr_image);
+    uint64_t start = region * anaInfo->region_size;
+    uint64_t end = start + anaInfo->region_size < anaInfo->pixel_size ? start + anaInfo->region_size : anaInfo->pixel_size;
+    // blocks hold whole groups so none is split
+    size_t group_bytes = ANALYZE_GROUP_PIXELS * anaInfo->bytes_per_pixel;
+    size_t step = IO_BLOCK_SIZE / group_bytes * group_bytes;
+
+    unsigned char *block = (unsigned char *)block_pool_get(shared_block_pool());
+    if (block == NULL)
+    {
+        anaInfo->error = 1;
+        return;
+    }
+    for (uint64_t offset = start; offset < end; offset += step)
+    {
+        size_t len = end - offset < step ? end - offset : step;
+        for (size_t done = 0; done < len;)
+        {
+            ssize_t n = pread(fd, block + done, len - done, anaInfo->pixel_offset + offset + done);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+            {
+                anaInfo->error = 1;
+                block_pool_put(shared_block_pool(), (char *)block);
+                return;
+            }
+            done += n;
+        }
+        histogram_bytes(block, len, stats->histogram);
+        rs_count_groups(block, len, anaInfo->bytes_per_pixel, stats->rs);
+    }
+    block_pool_put(shared_block_pool(), (char *)block);
+    worker_pool_add_bytes(&anaInfo->pool, worker_id, end - start);
+}
+
+/* Do analysis function
+ * Inputs: anaInfo
+ * Output: Regions are analysed in parallel, chi-square probability and RS
+ * estimate, or no estimate when RS has no valid root, are printed per region
+ * and for the whole image
+ * Return Value: e_success or e_failure
+ */
+Status do_analysis(AnalyzeInfo *anaInfo)
+{
+    anaInfo->fptr_image = fopen(anaInfo->image_fname, "r");
+    if (anaInfo->fptr_image == NULL)
+    {
+        perror("fopen ");
+        fprintf(stderr, "ERROR : Unable to open file %s\n", anaInfo->image_fname);
+        return e_failure;
+    }
+    if (read_analyze_header(anaInfo) == e_success)
+    {
+        printf("INFO : Reading image header successful\n");
+    }
+    else
+    {
+        printf("ERROR : Reading image header failed\n");
+        fclose(anaInfo->fptr_image);
+        return e_failure;
+    }
+
+    // regions hold whole groups so none is split between workers
+    size_t group_bytes = ANALYZE_GROUP_PIXELS * anaInfo->bytes_per_pixel;
+    if (anaInfo->region_size < group_bytes)
+        anaInfo->region_size = group_bytes;
+    anaInfo->region_size -= anaInfo->region_size % group_bytes;
+    anaInfo->num_regions = (anaInfo->pixel_size + anaInfo->region_size - 1) / anaInfo->region_size;
+    // stats of every region are kept for the report, so their number is bounded
+    if (anaInfo->num_regions > ANALYZE_MAX_REGIONS)
+    {
+        // groups per region, rounded up so the regions cover a trailing partial group too
+        uint64_t region_groups = (anaInfo->pixel_size / group_bytes + ANALYZE_MAX_REGIONS) / ANALYZE_MAX_REGIONS;
+        anaInfo->region_size = region_groups * group_bytes;
+        anaInfo->num_regions = (anaInfo->pixel_size + anaInfo->region_size - 1) / anaInfo->region_size;
+        printf("INFO : Region size raised to %llu KB to keep %d regions at most\n",
+               (unsigned long long)anaInfo->region_size / 1024, ANALYZE_MAX_REGIONS);
+    }
+    anaInfo->regions = calloc(anaInfo->num_regions ? anaInfo->num_regions : 1, sizeof(RegionStats));
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    anaInfo->num_workers = online > 0 ? online : 1;
+    if (anaInfo->regions == NULL || worker_pool_start(&anaInfo->pool, anaInfo->num_workers, anaInfo->placement) != e_success)
+    {
+        printf("ERROR : Starting analysis workers failed\n");
+        free(anaInfo->regions);
+        fclose(anaInfo->fptr_image);
+        return e_failure;
+    }
+    printf("INFO : Analysing %llu regions of %llu KB on %u workers, %u nodes, placement %s\n", (unsigned long long)anaInfo->num_regions,
+           (unsigned long long)anaInfo->region_size / 1024, anaInfo->num_workers, anaInfo->pool.placement.num_nodes,
+           placement_policy_name(anaInfo->placement));
+    for (uint64_t r = 0; r < anaInfo->num_regions; r++)
+        worker_pool_submit(&anaInfo->pool, analyze_region, anaInfo, r, 1);
+    worker_pool_wait_idle(&anaInfo->pool);
+    WorkerPoolStats pool_stats;
+    worker_pool_get_stats(&anaInfo->pool, &pool_stats);
+    worker_pool_stop(&anaInfo->pool);
+    for (uint i = 0; i < pool_stats.num_nodes; i++)
+    {
+        WorkerNodeStats *node = &pool_stats.nodes[i];
+        // bytes per ns * 1000 is MB/s
+        printf("INFO : Node %d analysed %llu regions (%llu stolen) on %u workers at %.1f MB/s\n", node->node_id,
+               (unsigned long long)node->jobs_done, (unsigned long long)node->jobs_stolen, node->num_workers,
+               node->busy_ns ? node->bytes * 1000.0 / node->busy_ns : 0);
+    }
+    if (anaInfo->error)
+    {
+        printf("ERROR : Reading image data failed\n");
+        free(anaInfo->regions);
+        fclose(anaInfo->fptr_image);
+        return e_failure;
+    }
+
+    // per region scores, and the run of leading regions that look stegged
+    RegionStats total;
+    memset(&total, 0, sizeof(total));
+    uint64_t leading = 0;
+    int in_leading_run = 1;
+    for (uint64_t r = 0; r < anaInfo->num_regions; r++)
+    {
+        RegionStats *stats = &anaInfo->regions[r];
+        double chi_p = chi_square_probability(stats->histogram);
+        char text[16];
+        printf("INFO : Region %llu offset %llu chi-square p %.3f RS estimate %s\n", (unsigned long long)r,
+               (unsigned long long)(anaInfo->pixel_offset + r * anaInfo->region_size), chi_p,
+               rs_estimate_text(rs_estimate(stats->rs), text));
+        if (in_leading_run && chi_p > 0.5)
+            leading++;
+        else
+            in_leading_run = 0;
+        for (uint v = 0; v < 256; v++)
+            total.histogram[v] += stats->histogram[v];
+        for (uint i = 0; i < e_rs_counters; i++)
+            total.rs[i] += stats->rs[i];
+    }
+    double rs_p = rs_estimate(total.rs);
+    char text[16];
+    printf("INFO : Whole image chi-square p %.3f RS estimate %s", chi_square_probability(total.histogram), rs_estimate_text(rs_p, text));
+    if (rs_p != ANALYZE_NO_ESTIMATE)
+        printf(" (about %llu bytes of LSB payload)", (unsigned long long)(rs_p * anaInfo->pixel_size / 8));
+    printf("\n");
+    printf("INFO : Leading regions with chi-square p > 0.5: %llu\n", (unsigned long long)leading);
+
+    free(anaInfo->regions);
+    fclose(anaInfo->fptr_image);
+    return e_success;
+}
@@ -0,0 +1,91 @@
+#ifndef ANALYZE_H
+#define ANALYZE_H
+
+#include <stdio.h>
+#include "types.h" // Contains user defined types
+#include "worker_pool.h"
+
+/*
+ * Structure to store information required for
+ * steganalysis of an image. The pixel array is split
+ * in regions which are analysed in parallel, each in
+ * a single pass, with chi-square and RS analysis. RS
+ * gives no estimate for flat or saturated regions, or
+ * for payloads in more than half of the pixels
+ */
+
+#define ANALYZE_DEFAULT_REGION_KB 1024
+#define ANALYZE_GROUP_PIXELS 4
+#define ANALYZE_CHI_MIN_EXPECTED 5
+/* Regions kept in memory, larger images get larger regions */
+#define ANALYZE_MAX_REGIONS 4096
+/* RS estimate when the counters give no usable root */
+#define ANALYZE_NO_ESTIMATE -1.0
+
+/* Index of RS counters, M is the mask [0 1 1 0] and N the negative mask */
+typedef enum
+{
+    e_rs_regular_m,
+    e_rs_singular_m,
+    e_rs_regular_n,
+    e_rs_singular_n,
+    e_rs_flipped_regular_m,
+    e_rs_flipped_singular_m,
+    e_rs_flipped_regular_n,
+    e_rs_flipped_singular_n,
+    e_rs_counters
+} RsCounter;
+
+/* Stats gathered from one region of the pixel array */
+typedef struct _RegionStats
+{
+    uint64_t histogram[256];
+    uint64_t rs[e_rs_counters];
+} RegionStats;
+
+typedef struct _AnalyzeInfo
+{
+    /* Image info */
+    char *image_fname;
+    FILE *fptr_image;
+    uint64_t pixel_offset;
+    uint64_t pixel_size;
+    uint bytes_per_pixel;
+
+    /* Regions analysed in parallel */
+    uint64_t region_size;
+    uint64_t num_regions;
+    RegionStats *regions;
+    uint num_workers;
+    PlacementPolicy placement;
+    WorkerPool pool;
+    int error;
+} AnalyzeInfo;
+
+/* Analysis function prototype */
+
+/* Read and validate analyze args from argv */
+Status read_and_validate_analyze_args(char *argv[], AnalyzeInfo *anaInfo);
+
+/* Perform the analysis */
+Status do_analysis(AnalyzeInfo *anaInfo);
+
+/* Read pixel span and bits per pixel from image header */
+Status read_analyze_header(AnalyzeInfo *anaInfo);
+
+/* Gather stats of one region, runs on a worker */
+void analyze_region(void *arg, long region, uint worker_id);
+
+/* Count byte values of a buffer */
+void histogram_bytes(const unsigned char *data, size_t size, uint64_t *histogram);
+
+/* Count RS groups of a buffer */
+void rs_count_groups(const unsigned char *data, size_t size, uint bytes_per_pixel, uint64_t *rs);
+
+/* Chi-square probability of LSB embedding from a histogram */
+double chi_square_probability(const uint64_t *histogram);
+
+/* RS estimate of the fraction of pixels carrying a message, or ANALYZE_NO_ESTIMATE */
+double rs_estimate(const uint64_t *rs);
+
+#endif
@@ -0,0 +1,437 @@
+// 64 bit file offsets so multi-GB carriers and payloads work
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "carrier.h"
+#include "types.h"
+#include "common.h"
+
+/* Function Definitions */
+
+/* Probe BMP
+ * Inputs: Start of file and its length
+ * Return Value: 1 if it starts with the BM signature, else 0
+ */
+static int carrier_bmp_probe(const unsigned char *head, size_t len)
+{
+    return len >= CARRIER_HEADER_SIZE && head[0] == 'B' && head[1] == 'M';
+}
+
+/* Parse BMP header
+ * Inputs: Start of file, its length and carrier info
+ * Output: Pixel array offset is stored in offset 10, width in offset 18,
+ * height after that, all 4 bytes. Bits per pixel is stored in offset 28 and
+ * is 2 bytes, compression in offset 30 is 4 bytes. Height is negative for
+ * top-down images. Pixel span runs to the end of file, row padding
+ * included, as stego images always had it
+ * Return Value: e_success or e_failure, compressed images are not supported
+ * as embedding would corrupt their data. BI_BITFIELDS is only accepted for
+ * 32 bit pixels, whose channels are still whole bytes. 1, 4 and 8 bit
+ * palette images and 16 bit 5-6-5 or 5-5-5 images are not supported, as
+ * their LSBs are palette indices or the low bits of packed fields, like
+ * the color mapped TGA images rejected by that format
+ */
+static Status carrier_bmp_parse(const unsigned char *head, size_t len, CarrierInfo *info)
+{
+    (void)len;
+    memcpy(&info->pixel_offset, head + 10, sizeof(uint32_t));
+    memcpy(&info->width, head + 18, sizeof(int32_t));
+    memcpy(&info->height, head + 22, sizeof(int32_t));
+    memcpy(&info->bits_per_pixel, head + 28, sizeof(uint16_t));
+    uint32_t compression;
+    memcpy(&compression, head + 30, sizeof(uint32_t));
+    // BITMAPINFOHEADER or a later one
+    if (info->pixel_offset < CARRIER_HEADER_SIZE)
+        return e_failure;
+    if (compression != CARRIER_BMP_RGB && !(compression == CARRIER_BMP_BITFIELDS && info->bits_per_pixel == 32))
+    {
+        printf("INFO : Only uncompressed BMP carriers are supported, compression %u is not\n", compression);
+        return e_failure;
+    }
+    // LSBs of palette indices and packed 16 bit fields are not low order color bits
+    if (info->bits_per_pixel != 24 && info->bits_per_pixel != 32)
+    {
+        printf("INFO : Only 24 and 32 bit BMP carriers are supported, %u bit is not\n", info->bits_per_pixel);
+        return e_failure;
+    }
+    uint64_t width = llabs(info->width), height = llabs(info->height);
+    info->stride = (width * info->bits_per_pixel + 31) / 32 * 4;
+    info->capacity = width * height * (info->bits_per_pixel / 8);
+    info->pixel_end = info->size;
+    return e_success;
+}
+
+/* Probe PPM
+ * Inputs: Start of file and its length
+ * Return Value: 1 if it starts with the binary PPM signature P6, else 0
+ */
+static int carrier_ppm_probe(const unsigned char *head, size_t len)
+{
+    return len >= 3 && head[0] == 'P' && head[1] == '6' && isspace(head[2]);
+}
+
+/* Probe PGM
+ * Inputs: Start of file and its length
+ * Return Value: 1 if it starts with the binary PGM signature P5, else 0
+ */
+static int carrier_pgm_probe(const unsigned char *head, size_t len)
+{
+    return len >= 3 && head[0] == 'P' && head[1] == '5' && isspace(head[2]);
+}
+
+/* Parse PPM or PGM header
+ * Inputs: Start of file, its length and carrier info
+ * Output: Width, height and maxval are read as ASCII numbers after the
+ * signature, separated by whitespace and # comments. A single whitespace
+ * byte ends the header, samples follow it, 3 per pixel for PPM and 1 for PGM
+ * Return Value: e_success or e_failure, 16 bit samples are not supported as
+ * the LSB of their high byte is not a low order bit
+ */
+static Status carrier_pnm_parse(const unsigned char *head, size_t len, CarrierInfo *info)
+{
+    uint64_t fields[3];
+    size_t pos = 2;
+    for (uint i = 0; i < 3; i++)
+    {
+        // whitespace and comments before each field
+        while (pos < len && (isspace(head[pos]) || head[pos] == '#'))
+        {
+            if (head[pos] == '#')
+                while (pos < len && head[pos] != '\n')
+                    pos++;
+            else
+                pos++;
+        }
+        if (pos >= len || !isdigit(head[pos]))
+            return e_failure;
+        fields[i] = 0;
+        while (pos < len && isdigit(head[pos]))
+        {
+            fields[i] = fields[i] * 10 + (head[pos++] - '0');
+            if (fields[i] > INT32_MAX)
+                return e_failure;
+        }
+    }
+    if (pos >= len || !isspace(head[pos]))
+        return e_failure;
+    if (fields[2] == 0 || fields[2] > 255)
+    {
+        printf("INFO : Only PPM and PGM carriers with 8 bit samples are supported\n");
+        return e_failure;
+    }
+    uint channels = head[1] == '6' ? 3 : 1;
+    info->width = fields[0];
+    info->height = fields[1];
+    info->pixel_offset = pos + 1;
+    info->bits_per_pixel = channels * 8;
+    info->stride = fields[0] * channels;
+    info->capacity = fields[0] * fields[1] * channels;
+    info->pixel_end = info->pixel_offset + info->capacity;
+    return e_success;
+}
+
+/* Probe TGA
+ * Inputs: Start of file and its length
+ * Output: TGA has no signature at the start, the header fields are checked
+ * for sane values instead. Formats with a signature are probed first
+ * Return Value: 1 if the header looks like a TGA header, else 0
+ */
+static int carrier_tga_probe(const unsigned char *head, size_t len)
+{
+    if (len < 18 || head[1] > 1)
+        return 0;
+    uint type = head[2], depth = head[16];
+    uint width = head[12] | head[13] << 8, height = head[14] | head[15] << 8;
+    if (type != 1 && type != 2 && type != 3 && type != 9 && type != 10 && type != 11)
+        return 0;
+    if (depth != 8 && depth != 15 && depth != 16 && depth != 24 && depth != 32)
+        return 0;
+    return width > 0 && height > 0;
+}
+
+/* Parse TGA header
+ * Inputs: Start of file, its length and carrier info
+ * Output: 18 byte header, id field of length in offset 0 and color map of
+ * length in offset 5 with entry bits in offset 7 come before the pixels.
+ * Width is stored in offset 12 and height in offset 14, 2 bytes little endian.
+ * Pixel depth is in offset 16. Footer or extension area after the pixels is
+ * kept unchanged
+ * Return Value: e_success or e_failure, RLE compressed, color mapped and
+ * 16 bit images are not supported, their LSBs are not low order color bits
+ */
+static Status carrier_tga_parse(const unsigned char *head, size_t len, CarrierInfo *info)
+{
+    (void)len;
+    uint type = head[2], depth = head[16];
+    if (!(type == 2 && (depth == 24 || depth == 32)) && !(type == 3 && depth == 8))
+    {
+        printf("INFO : Only uncompressed true color and grayscale TGA carriers are supported\n");
+        return e_failure;
+    }
+    uint cmap_size = head[1] ? (head[5] | head[6] << 8) * ((head[7] + 7) / 8) : 0;
+    uint64_t width = head[12] | head[13] << 8, height = head[14] | head[15] << 8;
+    info->width = width;
+    info->height = height;
+    info->pixel_offset = 18 + head[0] + cmap_size;
+    info->bits_per_pixel = depth;
+    info->stride = width * (depth / 8);
+    info->capacity = width * height * (depth / 8);
+    info->pixel_end = info->pixel_offset + info->capacity;
+    return e_success;
+}
+
+/* Write header by copying it
+ * Inputs: Parsed carrier header, Source and Stego image file pointers
+ * Output: Bytes before the pixel span are written to stego image, from the
+ * carrier info when the header fits in it, without reading src image again.
+ * Src image is positioned at the pixel span
+ * Return Value: e_success or e_failure
+ */
+static Status carrier_write_header_copy(const CarrierInfo *info, FILE *fptr_src_image, FILE *fptr_dest_image)
+{
+    if (info->pixel_offset <= CARRIER_HEADER_SIZE)
+    {
+        if (fseeko(fptr_src_image, info->pixel_offset, SEEK_SET) != 0)
+            return e_failure;
+        if (fwrite(info->header, sizeof(char), info->pixel_offset, fptr_dest_image) != info->pixel_offset)
+            return e_failure;
+        return e_success;
+    }
+    // longer headers, eg. BMP with a palette, are copied from src image
+    char buff[CARRIER_PROBE_SIZE];
+    if (fseeko(fptr_src_image, 0, SEEK_SET) != 0)
+        return e_failure;
+    for (uint64_t remaining = info->pixel_offset; remaining > 0;)
+    {
+        size_t chunk = remaining < sizeof(buff) ? remaining : sizeof(buff);
+        if (fread(buff, sizeof(char), chunk, fptr_src_image) != chunk || fwrite(buff, sizeof(char), chunk, fptr_dest_image) != chunk)
+            return e_failure;
+        remaining -= chunk;
+    }
+    return e_success;
+}
+
+/* Formats in probe order, indexed by CarrierFormatType */
+static const CarrierFormat carrier_formats[] = {
+    {"BMP", ".bmp", "stego.bmp", carrier_bmp_probe, carrier_bmp_parse, carrier_write_header_copy},
+    {"PPM", ".ppm", "stego.ppm", carrier_ppm_probe, carrier_pnm_parse, carrier_write_header_copy},
+    {"PGM", ".pgm", "stego.pgm", carrier_pgm_probe, carrier_pnm_parse, carrier_write_header_copy},
+    {"TGA", ".tga", "stego.tga", carrier_tga_probe, carrier_tga_parse, carrier_write_header_copy},
+};
+
+/* Get format by file name
+ * Input: File name
+ * Return Value: Format whose extension the name has, or NULL
+ */
+const CarrierFormat *carrier_format_by_name(const char *fname)
+{
+    const char *extn = strrchr(fname, '.');
+    if (extn == NULL)
+        return NULL;
+    for (uint i = 0; i < e_carrier_unknown; i++)
+    {
+        if (strcmp(extn, carrier_formats[i].extn) == 0)
+            return &carrier_formats[i];
+    }
+    return NULL;
+}
+
+/* Get format of a carrier
+ * Input: Parsed carrier info
+ * Return Value: Format the header was parsed as, or NULL
+ */
+const CarrierFormat *carrier_format(const CarrierInfo *info)
+{
+    return info->format < e_carrier_unknown ? &carrier_formats[info->format] : NULL;
+}
+
+/* Parse carrier header
+ * Inputs: File descriptor and carrier info with size set
+ * Output: Format is probed from the first bytes and its header parsed, start
+ * of the header is kept in info. Stegged is set if the magic string is found
+ * in the LSBs at the start of the pixel span
+ * Return Value: e_success or e_failure, if the format is not known or the
+ * pixel span is not inside the file
+ */
+Status carrier_parse(int fd, CarrierInfo *info)
+{
+    unsigned char head[CARRIER_PROBE_SIZE];
+    ssize_t len = pread(fd, head, sizeof(head), 0);
+    if (len <= 0)
+        return e_failure;
+    info->format = e_carrier_unknown;
+    for (uint i = 0; i < e_carrier_unknown; i++)
+    {
+        if (carrier_formats[i].probe(head, len))
+        {
+            info->format = i;
+            break;
+        }
+    }
+    if (info->format == e_carrier_unknown || carrier_formats[info->format].parse(head, len, info) != e_success)
+        return e_failure;
+    if (info->pixel_offset > info->pixel_end || info->pixel_end > info->size)
+        return e_failure;
+    // bits are only embedded inside the pixel span
+    if (info->capacity > info->pixel_end - info->pixel_offset)
+        info->capacity = info->pixel_end - info->pixel_offset;
+    memcpy(info->header, head, (size_t)len < CARRIER_HEADER_SIZE ? (size_t)len : CARRIER_HEADER_SIZE);
+
+    char lsb[8 * (sizeof(MAGIC_STRING) - 1)];
+    char magic[sizeof(MAGIC_STRING)] = {0};
+    info->stegged = 0;
+    if (pread(fd, lsb, sizeof(lsb), info->pixel_offset) == sizeof(lsb))
+    {
+        for (uint i = 0; i < sizeof(lsb); i++)
+            magic[i / 8] = (magic[i / 8] << 1) | (lsb[i] & 1);
+        info->stegged = strcmp(magic, MAGIC_STRING) == 0;
+    }
+    return e_success;
+}
+
+/* Copy header of src image to stego image
+ * Inputs: Parsed carrier header, Source and Stego image file pointers
+ * Output: Header is written by the format of the carrier, src image is
+ * positioned at the pixel span
+ * Return Value: e_success or e_failure
+ */
+Status carrier_copy_header(const CarrierInfo *info, FILE *fptr_src_image, FILE *fptr_dest_image)
+{
+    const CarrierFormat *format = carrier_format(info);
+    if (format == NULL)
+        return e_failure;
+    return format->write_header(info, fptr_src_image, fptr_dest_image);
+}
+
+/* Store little endian field
+ * Inputs: Destination, value and field length in bytes
+ */
+static void carrier_put_le(unsigned char *dest, uint64_t value, uint len)
+{
+    for (uint i = 0; i < len; i++)
+        dest[i] = value >> (8 * i);
+}
+
+/* Synthesize BMP carrier
+ * Inputs: carrier info, width, height, bits per pixel of 24 or 32 and
+ * payload bits to embed
+ * Output: A width or height of 0 is sized from the payload, both 0 give the
+ * smallest near square image whose capacity exceeds the payload bits, as
+ * check_capacity needs. Sized 24 bit widths are a multiple of 4, so rows
+ * have no padding and the file is the header and samples only. Header of a
+ * bottom-up BI_RGB BMP is built in info
+ * Return Value: e_success or e_failure, if the payload does not fit or the
+ * image is too large for a BMP
+ */
+Status carrier_synthesize(CarrierInfo *info, uint64_t width, uint64_t height, uint bits_per_pixel, uint64_t payload_bits)
+{
+    if (bits_per_pixel != 24 && bits_per_pixel != 32)
+        return e_failure;
+    uint bytes_per_pixel = bits_per_pixel / 8;
+    // capacity must be more than the payload bits
+    uint64_t pixels = (payload_bits + bytes_per_pixel) / bytes_per_pixel;
+    if (width == 0 && height == 0)
+    {
+        width = sqrt((double)pixels);
+        while (width * width < pixels)
+            width++;
+        if (bytes_per_pixel == 3)
+            width = (width + 3) / 4 * 4;
+    }
+    else if (width == 0)
+    {
+        width = (pixels + height - 1) / height;
+    }
+    if (height == 0)
+        height = (pixels + width - 1) / width;
+
+    memset(info, 0, sizeof(*info));
+    if (width > INT32_MAX || height > INT32_MAX)
+        return e_failure;
+    info->width = width;
+    info->height = height;
+    info->pixel_offset = CARRIER_HEADER_SIZE;
+    info->bits_per_pixel = bits_per_pixel;
+    info->format = e_carrier_bmp;
+    info->stride = (width * bits_per_pixel + 31) / 32 * 4;
+    info->capacity = width * height * bytes_per_pixel;
+    info->size = info->pixel_end = CARRIER_HEADER_SIZE + (uint64_t)info->stride * height;
+    // file size field is 32 bits
+    if (info->capacity <= payload_bits || info->size > UINT32_MAX)
+        return e_failure;
+
+    unsigned char *head = info->header;
+    head[0] = 'B';
+    head[1] = 'M';
+    carrier_put_le(head + 2, info->size, 4);
+    carrier_put_le(head + 10, CARRIER_HEADER_SIZE, 4);
+    carrier_put_le(head + 14, CARRIER_BMP_INFO_SIZE, 4);
+    carrier_put_le(head + 18, width, 4);
+    carrier_put_le(head + 22, height, 4);
+    carrier_put_le(head + 26, 1, 2);
+    carrier_put_le(head + 28, bits_per_pixel, 2);
+    carrier_put_le(head + 34, info->size - CARRIER_HEADER_SIZE, 4);
+    carrier_put_le(head + 38, CARRIER_BMP_PPM, 4);
+    carrier_put_le(head + 42, CARRIER_BMP_PPM, 4);
+    return e_success;
+}
+
+/* Noise word of a synthesized carrier
+ * Inputs: Seed and index of the 8 byte word after the header
+ * Return Value: splitmix64 of the seed and index
+ */
+static uint64_t carrier_synth_noise(uint64_t seed, uint64_t index)
+{
+    uint64_t z = seed + (index + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/* Get bytes of a synthesized carrier
+ * Inputs: Synthesized carrier info, seed, destination buffer, size and offset
+ * Output: Header bytes, then noise. Each 8 bytes of noise only depend on
+ * the seed and their index, so any range is made without the bytes before it
+ */
+void carrier_synth_fill(const CarrierInfo *info, uint64_t seed, char *buffer, size_t size, uint64_t offset)
+{
+    while (size > 0 && offset < info->pixel_offset)
+    {
+        *buffer++ = info->header[offset++];
+        size--;
+    }
+    while (size > 0)
+    {
+        uint64_t pos = offset - info->pixel_offset;
+        uint64_t noise = carrier_synth_noise(seed, pos / 8);
+        uint first = pos % 8;
+        size_t len = 8 - first < size ? 8 - first : size;
+        for (uint i = 0; i < len; i++)
+            buffer[i] = noise >> (8 * (first + i));
+        buffer += len;
+        offset += len;
+        size -= len;
+    }
+}
+
+/* Get random seed
+ * Return Value: Seed from /dev/urandom, or from the time and process id if
+ * it can not be read. Two carriers with the same seed are the same image,
+ * which would give their payloads away by a diff
+ */
+uint64_t carrier_synth_seed(void)
+{
+    uint64_t seed = 0;
+    FILE *fptr = fopen("/dev/urandom", "r");
+    if (fptr == NULL || fread(&seed, sizeof(seed), 1, fptr) != 1)
+        seed = (uint64_t)time(NULL) << 32 ^ (uint64_t)getpid();
+    if (fptr != NULL)
+        fclose(fptr);
+    return seed;
+}
@@ -0,0 +1,112 @@
+#ifndef CARRIER_H
+#define CARRIER_H
+
+#include <stdio.h>
+#include "types.h" // Contains user defined types
+
+/*
+ * Carrier formats. Each format can probe the first bytes
+ * of a file and parse its header into a CarrierInfo: the
+ * dimensions, capacity and the pixel span, the byte range
+ * holding samples. Bits are embedded in the LSBs of the
+ * pixel span from its start, everything before it is the
+ * header and is written by the format, so every format
+ * feeds the same block embed engine. All formats store
+ * their samples in one range and keep the header unchanged. Supported are BMP, binary PPM
+ * and PGM with 8 bit samples and uncompressed true color
+ * or grayscale TGA
+ *
+ * A BMP carrier can also be synthesized instead of read:
+ * its header is built from the dimensions and its pixels
+ * are noise from a seeded counter based generator, so
+ * any byte range is made without reading anything
+ */
+
+#define CARRIER_HEADER_SIZE 54
+/* Bytes read for probing, a header must fit in them */
+#define CARRIER_PROBE_SIZE 4096
+/* Carrier argument of encoding that synthesizes the carrier */
+#define CARRIER_SYNTH_FLAG "--synthesize"
+/* BITMAPINFOHEADER size and resolution of 72 DPI in pixels per metre */
+#define CARRIER_BMP_INFO_SIZE 40
+#define CARRIER_BMP_PPM 2835
+/* BMP compression of uncompressed pixels, and of 32 bit pixels with channel masks */
+#define CARRIER_BMP_RGB 0
+#define CARRIER_BMP_BITFIELDS 3
+
+typedef enum
+{
+    e_carrier_bmp,
+    e_carrier_ppm,
+    e_carrier_pgm,
+    e_carrier_tga,
+    e_carrier_unknown
+} CarrierFormatType;
+
+/* Parsed carrier header */
+typedef struct _CarrierInfo
+{
+    /* Key, identifies a version of a file */
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t mtime_ns;
+    uint64_t size;
+
+    /* Header fields */
+    int32_t width;
+    int32_t height;
+    uint32_t pixel_offset;
+    uint32_t stride;
+    uint16_t bits_per_pixel;
+    uint8_t stegged;
+    uint8_t format;
+    uint64_t capacity;
+
+    /* Pixel span ends here, bytes after it are copied unchanged */
+    uint64_t pixel_end;
+
+    /* Start of the header, whole header if pixel_offset fits */
+    unsigned char header[CARRIER_HEADER_SIZE];
+} CarrierInfo;
+
+/* Format backend */
+typedef struct _CarrierFormat
+{
+    const char *name;
+    const char *extn;
+    const char *default_stego_fname;
+
+    /* Does the start of a file look like this format */
+    int (*probe)(const unsigned char *head, size_t len);
+
+    /* Fill header fields, pixel span and capacity from the start of a file */
+    Status (*parse)(const unsigned char *head, size_t len, CarrierInfo *info);
+
+    /* Write header of the stego image, src image is left at the pixel span */
+    Status (*write_header)(const CarrierInfo *info, FILE *fptr_src_image, FILE *fptr_dest_image);
+} CarrierFormat;
+
+/* Carrier function prototype */
+
+/* Format of a file name by its extension, NULL if not a carrier */
+const CarrierFormat *carrier_format_by_name(const char *fname);
+
+/* Format of a parsed carrier */
+const CarrierFormat *carrier_format(const CarrierInfo *info);
+
+/* Probe and parse carrier header with pread */
+Status carrier_parse(int fd, CarrierInfo *info);
+
+/* Copy header of src image to stego image */
+Status carrier_copy_header(const CarrierInfo *info, FILE *fptr_src_image, FILE *fptr_dest_image);
+
+/* Build a BMP carrier fitting payload bits, 0 width or height is sized from it */
+Status carrier_synthesize(CarrierInfo *info, uint64_t width, uint64_t height, uint bits_per_pixel, uint64_t payload_bits);
+
+/* Get bytes of a synthesized carrier at offset */
+void carrier_synth_fill(const CarrierInfo *info, uint64_t seed, char *buffer, size_t size, uint64_t offset);
+
+/* Random seed for a synthesized carrier */
+uint64_t carrier_synth_seed(void);
+
+#endif
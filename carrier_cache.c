@@ -0,0 +1,258 @@
+// 64 bit file offsets so multi-GB carriers and payloads work
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "carrier_cache.h"
+#include "types.h"
+
+/* Cache file mapped by this process, NULL if caching is off */
+static CarrierCacheFile *cache_map;
+static pthread_once_t cache_once = PTHREAD_ONCE_INIT;
+static uint64_t cache_hits;
+static uint64_t cache_misses;
+
+/* Function Definitions */
+
+/* Map the cache file, runs once per process
+ * Output: cache_map points to the mapped file, a new file is sized and
+ * its header written under an exclusive flock
+ */
+static void carrier_cache_open(void)
+{
+    const char *path = getenv(CARRIER_CACHE_ENV);
+    if (path == NULL || *path == '\0')
+        return;
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        perror("open ");
+        printf("INFO : Carrier cache %s is not used\n", path);
+        return;
+    }
+    struct stat st;
+    flock(fd, LOCK_EX);
+    if (fstat(fd, &st) != 0 || ((uint64_t)st.st_size < sizeof(CarrierCacheFile) && ftruncate(fd, sizeof(CarrierCacheFile)) != 0))
+    {
+        flock(fd, LOCK_UN);
+        close(fd);
+        printf("INFO : Carrier cache %s is not used\n", path);
+        return;
+    }
+    CarrierCacheFile *map = mmap(NULL, sizeof(CarrierCacheFile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // new file is zero filled, every slot is empty
+    if (map != MAP_FAILED && map->magic[0] == '\0')
+    {
+        map->version = CARRIER_CACHE_VERSION;
+        map->num_slots = CARRIER_CACHE_SLOTS;
+        map->slot_size = sizeof(CarrierCacheSlot);
+        memcpy(map->magic, CARRIER_CACHE_MAGIC, sizeof(CARRIER_CACHE_MAGIC));
+    }
+    flock(fd, LOCK_UN);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        perror("mmap ");
+        printf("INFO : Carrier cache %s is not used\n", path);
+        return;
+    }
+    if (memcmp(map->magic, CARRIER_CACHE_MAGIC, sizeof(CARRIER_CACHE_MAGIC)) != 0 || map->version != CARRIER_CACHE_VERSION ||
+        map->num_slots != CARRIER_CACHE_SLOTS || map->slot_size != sizeof(CarrierCacheSlot))
+    {
+        munmap(map, sizeof(CarrierCacheFile));
+        printf("INFO : Carrier cache %s has another format and is not used\n", path);
+        return;
+    }
+    cache_map = map;
+}
+
+/* Hash of the carrier key
+ * Input: Carrier info with key set
+ * Return Value: Index of the first slot to probe
+ */
+static uint carrier_cache_hash(const CarrierInfo *info)
+{
+    uint64_t h = info->dev * 0x9E3779B97F4A7C15ULL ^ info->ino;
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    return h % CARRIER_CACHE_SLOTS;
+}
+
+/* Check if two infos have the same key
+ * Inputs: Carrier infos
+ * Return Value: 1 if device, inode, mtime and size match, else 0
+ */
+static int carrier_key_equal(const CarrierInfo *a, const CarrierInfo *b)
+{
+    return a->dev == b->dev && a->ino == b->ino && a->mtime_ns == b->mtime_ns && a->size == b->size;
+}
+
+/* Read a slot without locking
+ * Inputs: Slot and destination info
+ * Output: Consistent copy of the slot, retried while a writer changes it
+ * Return Value: e_success or e_failure, if the slot is being written, or was
+ * left locked by a writer that died, which the next store takes over
+ */
+static Status carrier_cache_read_slot(CarrierCacheSlot *slot, CarrierInfo *info)
+{
+    for (;;)
+    {
+        uint64_t lock = __atomic_load_n(&slot->lock, __ATOMIC_ACQUIRE);
+        if (lock & 1)
+            return e_failure;
+        memcpy(info, &slot->info, sizeof(CarrierInfo));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->lock, __ATOMIC_RELAXED) == lock)
+            return e_success;
+    }
+}
+
+/* Check if the writer of a locked slot is gone
+ * Input: Lock word of the slot
+ * Return Value: 1 if the process holding it no longer exists, else 0
+ */
+static int carrier_cache_writer_dead(uint64_t lock)
+{
+    pid_t pid = lock >> 32;
+    return pid > 0 && kill(pid, 0) != 0 && errno == ESRCH;
+}
+
+/* Take a slot for writing
+ * Input: Slot
+ * Output: Sequence goes from even to odd with our pid in the lock word. A
+ * slot left odd by a writer that died goes to the next odd sequence, so its
+ * readers keep missing till it is written again
+ * Return Value: Lock word now held, or 0 if a live writer holds the slot
+ */
+static uint64_t carrier_cache_lock_slot(CarrierCacheSlot *slot)
+{
+    uint64_t lock = __atomic_load_n(&slot->lock, __ATOMIC_RELAXED);
+    if ((lock & 1) && !carrier_cache_writer_dead(lock))
+        return 0;
+    uint32_t seq = (uint32_t)lock + ((lock & 1) ? 2 : 1);
+    uint64_t held = seq | (uint64_t)getpid() << 32;
+    if (!__atomic_compare_exchange_n(&slot->lock, &lock, held, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        return 0;
+    return held;
+}
+
+/* Look up a carrier in the cache
+ * Input: Carrier info with key set
+ * Output: Header fields are filled on a hit
+ * Return Value: e_success on a hit, e_failure on a miss
+ */
+static Status carrier_cache_lookup(CarrierInfo *info)
+{
+    uint index = carrier_cache_hash(info);
+    for (uint i = 0; i < CARRIER_CACHE_PROBES; i++)
+    {
+        CarrierInfo entry;
+        if (carrier_cache_read_slot(&cache_map->slots[(index + i) % CARRIER_CACHE_SLOTS], &entry) != e_success)
+            continue;
+        if (carrier_key_equal(&entry, info))
+        {
+            *info = entry;
+            return e_success;
+        }
+        // empty slot ends the probe sequence
+        if (entry.ino == 0 && entry.dev == 0)
+            break;
+    }
+    return e_failure;
+}
+
+/* Store a carrier in the cache
+ * Input: Carrier info
+ * Output: Written to the slot holding an older version of the same file,
+ * to an empty slot or one left locked by a writer that died, else the first
+ * slot probed is replaced. Nothing is written if a live writer holds the slot
+ */
+static void carrier_cache_store(const CarrierInfo *info)
+{
+    uint index = carrier_cache_hash(info);
+    CarrierCacheSlot *slot = &cache_map->slots[index];
+    for (uint i = 0; i < CARRIER_CACHE_PROBES; i++)
+    {
+        CarrierCacheSlot *probe = &cache_map->slots[(index + i) % CARRIER_CACHE_SLOTS];
+        CarrierInfo entry;
+        if (carrier_cache_read_slot(probe, &entry) != e_success)
+        {
+            // slot left locked by a writer that died is reused
+            if (carrier_cache_writer_dead(__atomic_load_n(&probe->lock, __ATOMIC_RELAXED)))
+            {
+                slot = probe;
+                break;
+            }
+            continue;
+        }
+        if ((entry.dev == info->dev && entry.ino == info->ino) || (entry.ino == 0 && entry.dev == 0))
+        {
+            slot = probe;
+            break;
+        }
+    }
+    uint64_t held = carrier_cache_lock_slot(slot);
+    if (held == 0)
+        return;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&slot->info, info, sizeof(CarrierInfo));
+    // even sequence without pid, unless a writer took the slot over meanwhile
+    __atomic_compare_exchange_n(&slot->lock, &held, (uint32_t)(held + 1), 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+/* Get parsed header of a carrier
+ * Inputs: Carrier image file pointer and carrier info
+ * Output: Info is filled from the cache on a hit, without reading the file.
+ * On a miss the header is parsed with pread and stored in the cache.
+ * Position of the file pointer is not changed
+ * Return Value: e_success or e_failure
+ */
+Status carrier_cache_get(FILE *fptr_image, CarrierInfo *info)
+{
+    struct stat st;
+    int fd = fileno(fptr_image);
+    if (fd < 0 || fstat(fd, &st) != 0)
+        return e_failure;
+    memset(info, 0, sizeof(CarrierInfo));
+    info->dev = st.st_dev;
+    info->ino = st.st_ino;
+    info->mtime_ns = (uint64_t)st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+    info->size = st.st_size;
+
+    pthread_once(&cache_once, carrier_cache_open);
+    // only regular files have a stable identity
+    int cached = cache_map != NULL && S_ISREG(st.st_mode);
+    if (cached && carrier_cache_lookup(info) == e_success)
+    {
+        __atomic_fetch_add(&cache_hits, 1, __ATOMIC_RELAXED);
+        return e_success;
+    }
+    if (carrier_parse(fd, info) != e_success)
+        return e_failure;
+    if (cached)
+    {
+        __atomic_fetch_add(&cache_misses, 1, __ATOMIC_RELAXED);
+        carrier_cache_store(info);
+    }
+    return e_success;
+}
+
+/* Cache hits and misses
+ * Inputs: Destination counters
+ * Output: Counts of this process since start
+ */
+void carrier_cache_stats(uint64_t *hits, uint64_t *misses)
+{
+    *hits = __atomic_load_n(&cache_hits, __ATOMIC_RELAXED);
+    *misses = __atomic_load_n(&cache_misses, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,57 @@
+#ifndef CARRIER_CACHE_H
+#define CARRIER_CACHE_H
+
+#include <stdio.h>
+#include "types.h" // Contains user defined types
+#include "carrier.h"
+
+/*
+ * Persistent cache of parsed carrier headers, so jobs
+ * reusing the same carriers skip header I/O. The cache
+ * is a file mapped with MAP_SHARED by every process and
+ * thread using it, a hash table of fixed size slots keyed
+ * by device, inode, mtime and size. Each slot is guarded
+ * by a sequence lock: readers never block and retry or
+ * miss while a slot is written, writers skip a slot being
+ * written by someone else. The lock word holds the pid of
+ * its writer, so a slot left locked by a process that
+ * died is taken over by the next writer, processes
+ * sharing a cache file must share a pid namespace. Path of the cache file is
+ * taken from the STEGO_CARRIER_CACHE environment variable,
+ * without it headers are parsed on every job
+ */
+
+#define CARRIER_CACHE_ENV "STEGO_CARRIER_CACHE"
+#define CARRIER_CACHE_MAGIC "STEGCCH"
+#define CARRIER_CACHE_VERSION 5
+#define CARRIER_CACHE_SLOTS 16384
+#define CARRIER_CACHE_PROBES 8
+
+/* Slot of the cache file, low 32 bits of lock are the sequence, odd while
+ * the slot is written, and high 32 bits the pid of the writer meanwhile */
+typedef struct _CarrierCacheSlot
+{
+    uint64_t lock;
+    CarrierInfo info;
+} __attribute__((aligned(64))) CarrierCacheSlot;
+
+/* Layout of the cache file */
+typedef struct _CarrierCacheFile
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t num_slots;
+    uint32_t slot_size;
+    uint32_t reserved[13];
+    CarrierCacheSlot slots[CARRIER_CACHE_SLOTS];
+} CarrierCacheFile;
+
+/* Carrier cache function prototype */
+
+/* Get parsed header of a carrier, from the cache when possible */
+Status carrier_cache_get(FILE *fptr_image, CarrierInfo *info);
+
+/* Cache hits and misses of this process */
+void carrier_cache_stats(uint64_t *hits, uint64_t *misses);
+
+#endif
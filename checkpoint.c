@@ -0,0 +1,348 @@
+// 64 bit file offsets so multi-GB carriers and payloads work
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "checkpoint.h"
+#include "steg_reader.h"
+#include "mem_pool.h"
+#include "durable.h"
+#include "types.h"
+
+/* Function Definitions */
+
+/* CRC-32 tables for slicing by 8, built once */
+static uint32_t crc_table[8][256];
+static pthread_once_t crc_table_once = PTHREAD_ONCE_INIT;
+
+/* Builds CRC-32 tables of the reflected polynomial, table k advances k more bytes */
+static void checkpoint_crc_table_init(void)
+{
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+            c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+        crc_table[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; i++)
+        for (int k = 1; k < 8; k++)
+            crc_table[k][i] = crc_table[0][crc_table[k - 1][i] & 0xFF] ^ (crc_table[k - 1][i] >> 8);
+}
+
+/* Update CRC-32 checksum
+ * Inputs: Checksum so far (0 to start), data and size
+ * Output: Reflected CRC-32 as used by zlib, so it can be chained over blocks.
+ * 8 bytes are folded per step with 8 tables
+ * Return Value: Updated checksum
+ */
+uint32_t checkpoint_crc32(uint32_t crc, const char *data, size_t size)
+{
+    const unsigned char *byte = (const unsigned char *)data;
+    pthread_once(&crc_table_once, checkpoint_crc_table_init);
+    crc = ~crc;
+    for (; size >= 8; size -= 8, byte += 8)
+    {
+        uint32_t low = crc ^ (byte[0] | byte[1] << 8 | byte[2] << 16 | (uint32_t)byte[3] << 24);
+        crc = crc_table[7][low & 0xFF] ^ crc_table[6][(low >> 8) & 0xFF] ^ crc_table[5][(low >> 16) & 0xFF] ^
+              crc_table[4][low >> 24] ^ crc_table[3][byte[4]] ^ crc_table[2][byte[5]] ^ crc_table[1][byte[6]] ^
+              crc_table[0][byte[7]];
+    }
+    while (size-- > 0)
+        crc = crc_table[0][(crc ^ *byte++) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+/* Get identity of an input file
+ * Inputs: File descriptor and key
+ * Return Value: e_success or e_failure
+ */
+static Status checkpoint_file_key(int fd, CheckpointFileKey *key)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        return e_failure;
+    key->dev = st.st_dev;
+    key->ino = st.st_ino;
+    key->mtime_ns = (uint64_t)st.st_mtim.tv_sec * 1000000000ULL + st.st_mtim.tv_nsec;
+    key->size = st.st_size;
+    return e_success;
+}
+
+/* Read and validate sidecar
+ * Inputs: Sidecar file name, partial output, checkpoint expected for the
+ * current inputs and destination checkpoint
+ * Output: Sidecar must be for the same inputs and all bytes of the partial
+ * output before the checkpoint must match its running checksum, so a
+ * segment damaged before the last one is found too. Reading them back is
+ * far cheaper than encoding them again
+ * Return Value: e_success if encoding can resume from it, else e_failure
+ */
+Status checkpoint_load(const char *ckpt_fname, int fd_part, const Checkpoint *expected, Checkpoint *checkpoint)
+{
+    int fd = open(ckpt_fname, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return e_failure;
+    ssize_t len = read(fd, checkpoint, sizeof(Checkpoint));
+    close(fd);
+    if (len != sizeof(Checkpoint) || memcmp(checkpoint->magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0 ||
+        checkpoint->version != CHECKPOINT_VERSION)
+    {
+        printf("INFO : Checkpoint %s is not valid, starting over\n", ckpt_fname);
+        return e_failure;
+    }
+    // extension read from disk may lack its null character
+    if (memcmp(&checkpoint->carrier, &expected->carrier, sizeof(CheckpointFileKey)) != 0 ||
+        memcmp(&checkpoint->secret, &expected->secret, sizeof(CheckpointFileKey)) != 0 ||
+        memchr(checkpoint->extn, '\0', sizeof(checkpoint->extn)) == NULL ||
+        strncmp(checkpoint->extn, expected->extn, sizeof(checkpoint->extn)) != 0)
+    {
+        printf("INFO : Checkpoint %s is for other inputs, starting over\n", ckpt_fname);
+        return e_failure;
+    }
+
+    // every checkpointed byte of the partial output must be as it was written
+    struct stat st;
+    if (fstat(fd_part, &st) != 0 || (uint64_t)st.st_size < checkpoint->output_offset)
+    {
+        printf("INFO : Partial output is shorter than checkpoint, starting over\n");
+        return e_failure;
+    }
+    char *block = block_pool_get(shared_block_pool());
+    if (block == NULL)
+        return e_failure;
+    uint32_t crc = 0;
+    uint64_t offset = 0;
+    while (offset < checkpoint->output_offset)
+    {
+        uint64_t remaining = checkpoint->output_offset - offset;
+        ssize_t ret = pread(fd_part, block, remaining < IO_BLOCK_SIZE ? remaining : IO_BLOCK_SIZE, offset);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            break;
+        crc = checkpoint_crc32(crc, block, ret);
+        offset += ret;
+    }
+    block_pool_put(shared_block_pool(), block);
+    if (offset != checkpoint->output_offset || crc != checkpoint->checksum)
+    {
+        printf("INFO : Partial output does not match checkpoint, starting over\n");
+        return e_failure;
+    }
+    return e_success;
+}
+
+/* Durably write sidecar
+ * Inputs: Sidecar file name and checkpoint
+ * Output: Written to a temporary file, synced and renamed over the sidecar,
+ * so a crash leaves either the old or the new checkpoint
+ * Return Value: e_success or e_failure
+ */
+Status checkpoint_save(const char *ckpt_fname, const Checkpoint *checkpoint)
+{
+    char tmp_fname[CHECKPOINT_PATH_MAX];
+    if (snprintf(tmp_fname, sizeof(tmp_fname), "%s.tmp", ckpt_fname) >= (int)sizeof(tmp_fname))
+        return e_failure;
+    int fd = open(tmp_fname, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return e_failure;
+    if (write(fd, checkpoint, sizeof(Checkpoint)) != sizeof(Checkpoint) || fsync(fd) != 0)
+    {
+        close(fd);
+        unlink(tmp_fname);
+        return e_failure;
+    }
+    close(fd);
+    if (rename(tmp_fname, ckpt_fname) != 0)
+        return e_failure;
+    return durable_sync_dir(ckpt_fname);
+}
+
+/* Write all bytes at offset
+ * Inputs: File descriptor, data, size and offset
+ * Return Value: e_success or e_failure
+ */
+static Status checkpoint_pwrite(int fd, const char *data, size_t size, uint64_t offset)
+{
+    while (size > 0)
+    {
+        ssize_t ret = pwrite(fd, data, size, offset);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return e_failure;
+        data += ret;
+        size -= ret;
+        offset += ret;
+    }
+    return e_success;
+}
+
+/* Open files of a checkpointed encoding
+ * Inputs: encInfo and part file name
+ * Output: Src image and secret are opened for reading, part file is opened
+ * for writing without truncating it, so it can be resumed
+ * Return Value: e_success or e_failure
+ */
+static Status checkpoint_open_files(EncodeInfo *encInfo, const char *part_fname)
+{
+    encInfo->fptr_src_image = fopen(encInfo->src_image_fname, "r");
+    if (encInfo->fptr_src_image == NULL)
+    {
+        perror("fopen ");
+        fprintf(stderr, "ERROR : Unable to open file %s\n", encInfo->src_image_fname);
+        return e_failure;
+    }
+    encInfo->fptr_secret = fopen(encInfo->secret_fname, "r");
+    if (encInfo->fptr_secret == NULL)
+    {
+        perror("fopen ");
+        fprintf(stderr, "ERROR : Unable to open file %s\n", encInfo->secret_fname);
+        fclose(encInfo->fptr_src_image);
+        return e_failure;
+    }
+    int fd = open(part_fname, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0 || (encInfo->fptr_stego_image = fdopen(fd, "r+")) == NULL)
+    {
+        perror("open ");
+        fprintf(stderr, "ERROR : Unable to open file %s\n", part_fname);
+        if (fd >= 0)
+            close(fd);
+        fclose(encInfo->fptr_src_image);
+        fclose(encInfo->fptr_secret);
+        return e_failure;
+    }
+    return e_success;
+}
+
+/* Encode into the part file
+ * Inputs: encInfo with opened files, part and sidecar file names
+ * Output: Stego image is pulled from a stego reader into the part file,
+ * resuming from a valid checkpoint, with a checkpoint every
+ * CHECKPOINT_INTERVAL bytes. The part file is renamed to the stego image
+ * when complete and its directory synced
+ * Return Value: e_success or e_failure
+ */
+static Status checkpoint_encode(EncodeInfo *encInfo, const char *part_fname, const char *ckpt_fname)
+{
+    int fd_part = fileno(encInfo->fptr_stego_image);
+    StegReader reader;
+    strcpy(encInfo->extn_secret_file, strstr(encInfo->secret_fname, "."));
+    if (steg_reader_open(&reader, encInfo->fptr_src_image, encInfo->fptr_secret, encInfo->extn_secret_file) != e_success)
+    {
+        printf("ERROR : Opening stego reader failed\n");
+        return e_failure;
+    }
+
+    // checkpoint for the current inputs, resumed if the sidecar matches it
+    Checkpoint checkpoint, expected;
+    memset(&expected, 0, sizeof(expected));
+    memcpy(expected.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    expected.version = CHECKPOINT_VERSION;
+    strcpy(expected.extn, encInfo->extn_secret_file);
+    if (checkpoint_file_key(fileno(encInfo->fptr_src_image), &expected.carrier) != e_success ||
+        checkpoint_file_key(fileno(encInfo->fptr_secret), &expected.secret) != e_success)
+        return e_failure;
+    if (checkpoint_load(ckpt_fname, fd_part, &expected, &checkpoint) == e_success)
+    {
+        printf("INFO : Resuming from checkpoint at %llu of %llu bytes\n", (unsigned long long)checkpoint.output_offset,
+               (unsigned long long)steg_reader_size(&reader));
+    }
+    else
+    {
+        checkpoint = expected;
+    }
+
+    char *block = block_pool_get(shared_block_pool());
+    if (block == NULL)
+    {
+        printf("ERROR : Getting stream buffer failed\n");
+        return e_failure;
+    }
+    Status status = e_success;
+    uint64_t offset = checkpoint.output_offset;
+    uint64_t segment_offset = offset;
+    ssize_t len;
+    while ((len = steg_reader_pread(&reader, block, IO_BLOCK_SIZE, offset)) > 0)
+    {
+        if (checkpoint_pwrite(fd_part, block, len, offset) != e_success)
+        {
+            status = e_failure;
+            break;
+        }
+        checkpoint.checksum = checkpoint_crc32(checkpoint.checksum, block, len);
+        offset += len;
+        // data is durable before the checkpoint pointing past it
+        if (offset - segment_offset >= CHECKPOINT_INTERVAL)
+        {
+            checkpoint.output_offset = offset;
+            if (fdatasync(fd_part) != 0 || checkpoint_save(ckpt_fname, &checkpoint) != e_success)
+            {
+                status = e_failure;
+                break;
+            }
+            printf("INFO : Checkpoint at %llu bytes\n", (unsigned long long)offset);
+            // synced segment is not kept in the page cache
+            if (encInfo->cache_mode != e_io_cached)
+            {
+                io_drop_cache(fd_part, segment_offset, offset - segment_offset, e_io_write);
+                io_drop_cache(fileno(encInfo->fptr_src_image), segment_offset, offset - segment_offset, e_io_read);
+            }
+            segment_offset = offset;
+        }
+    }
+    block_pool_put(shared_block_pool(), block);
+    if (len < 0)
+        status = e_failure;
+    // a partial output of an earlier, longer carrier may be left past the end
+    if (status == e_success && (ftruncate(fd_part, offset) != 0 || fsync(fd_part) != 0 || rename(part_fname, encInfo->stego_image_fname) != 0 ||
+                                durable_sync_dir(encInfo->stego_image_fname) != e_success))
+        status = e_failure;
+    if (status != e_success)
+        return e_failure;
+    unlink(ckpt_fname);
+    printf("INFO : Stego image checksum %08x\n", checkpoint.checksum);
+    return e_success;
+}
+
+/* Do checkpointed encoding
+ * Inputs: encInfo with file names
+ * Output: Files are opened and encoded into the part file, which is renamed
+ * to the stego image when complete. On failure the files are closed here,
+ * part file and sidecar are kept for --resume
+ * Return Value: e_success or e_failure
+ */
+Status do_encoding_checkpointed(EncodeInfo *encInfo)
+{
+    char part_fname[CHECKPOINT_PATH_MAX], ckpt_fname[CHECKPOINT_PATH_MAX];
+    if (snprintf(part_fname, sizeof(part_fname), "%s%s", encInfo->stego_image_fname, CHECKPOINT_PART_SUFFIX) >= (int)sizeof(part_fname) ||
+        snprintf(ckpt_fname, sizeof(ckpt_fname), "%s%s", encInfo->stego_image_fname, CHECKPOINT_SUFFIX) >= (int)sizeof(ckpt_fname))
+    {
+        printf("ERROR : Stego image name is too long\n");
+        return e_failure;
+    }
+    if (checkpoint_open_files(encInfo, part_fname) == e_success)
+    {
+        printf("INFO : Files are opened successfully\n");
+    }
+    else
+    {
+        printf("ERROR : Opening files failed\n");
+        return e_failure;
+    }
+    if (checkpoint_encode(encInfo, part_fname, ckpt_fname) == e_success)
+        return e_success;
+    printf("ERROR : Writing stego image failed, run again with --resume to continue\n");
+    fclose(encInfo->fptr_src_image);
+    fclose(encInfo->fptr_secret);
+    fclose(encInfo->fptr_stego_image);
+    encInfo->fptr_src_image = encInfo->fptr_secret = encInfo->fptr_stego_image = NULL;
+    return e_failure;
+}
@@ -0,0 +1,68 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "types.h" // Contains user defined types
+#include "encode.h"
+
+/*
+ * Checkpointed encoding for very large carriers. The stego
+ * image is written to <stego>.part from a stego reader and
+ * every CHECKPOINT_INTERVAL bytes the data is synced and a
+ * sidecar <stego>.ckpt records the output offset, running
+ * checksum and identity of the inputs. Stego bytes only
+ * depend on carrier and secret, so an interrupted encode
+ * continues from the last checkpoint once its inputs and
+ * every checkpointed byte of the partial output, checked
+ * against the running checksum, are validated. The part
+ * file is renamed to the stego image when complete, its
+ * directory synced and the sidecar removed
+ */
+
+#define CHECKPOINT_MAGIC "STEGCKP"
+#define CHECKPOINT_VERSION 2
+#define CHECKPOINT_INTERVAL (256ULL << 20)
+#define CHECKPOINT_PART_SUFFIX ".part"
+#define CHECKPOINT_SUFFIX ".ckpt"
+#define CHECKPOINT_PATH_MAX 4096
+
+/* Identity of an input file */
+typedef struct _CheckpointFileKey
+{
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t mtime_ns;
+    uint64_t size;
+} CheckpointFileKey;
+
+/* Contents of the sidecar file */
+typedef struct _Checkpoint
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    CheckpointFileKey carrier;
+    CheckpointFileKey secret;
+    char extn[MAX_FILE_SUFFIX];
+    char reserved_extn[3];
+
+    /* Stego bytes before output_offset are durable, checksum is of all of them */
+    uint64_t output_offset;
+    uint32_t checksum;
+    uint32_t reserved_checksum;
+} Checkpoint;
+
+/* Checkpoint function prototype */
+
+/* Perform the encoding with checkpoints, resuming a previous one if valid */
+Status do_encoding_checkpointed(EncodeInfo *encInfo);
+
+/* Read and validate sidecar against inputs and partial output */
+Status checkpoint_load(const char *ckpt_fname, int fd_part, const Checkpoint *expected, Checkpoint *checkpoint);
+
+/* Durably write sidecar */
+Status checkpoint_save(const char *ckpt_fname, const Checkpoint *checkpoint);
+
+/* Update CRC-32 checksum with data */
+uint32_t checkpoint_crc32(uint32_t crc, const char *data, size_t size);
+
+#endif
@@ -4,4 +4,16 @@
 /* Magic string to identify whether stegged or not */
 #define MAGIC_STRING "#*"
 
+/* Header version encoded right after the magic string */
+#define STEGO_VERSION 2
+
+/* Header version of matrix embedded payloads, followed by the code parameter */
+#define STEGO_VERSION_MATRIX 3
+
+/* Images stegged before versioning hold a 32 bit extn size here, whose first byte is always 0 */
+#define STEGO_VERSION_LEGACY 0
+
+/* Max bytes taken by a varint encoded 64 bit length */
+#define MAX_VARINT_SIZE 10
+
 #endif
@@ -0,0 +1,490 @@
+// 64 bit file offsets so multi-GB carriers and payloads work
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include "compare.h"
+#include "carrier_cache.h"
+#include "io_engine.h"
+#include "mem_pool.h"
+#include "types.h"
+
+/* Function Definitions */
+
+/* Read and validate compare arguments
+ * Input: Command line arguments and cmpInfo
+ * Output: File names, tile size and bitmap file name are stored in cmpInfo
+ * Return: e_success or e_failure
+ */
+Status read_and_validate_compare_args(char *argv[], CompareInfo *cmpInfo)
+{
+    memset(cmpInfo, 0, sizeof(*cmpInfo));
+    // Checks if 2nd and 3rd arguments passed are carrier image files, .bmp, .ppm, .pgm or .tga
+    if (carrier_format_by_name(argv[2]) != NULL && argv[3] != NULL && carrier_format_by_name(argv[3]) != NULL)
+    {
+        // stores them in cmpInfo
+        cmpInfo->carrier_fname = argv[2];
+        cmpInfo->stego_fname = argv[3];
+    }
+    else
+    {
+        printf("INFO : Please mention carrier and steged image files correctly Eg:beautiful.bmp stego.bmp\n");
+        return e_failure;
+    }
+    // checks if tile size in pixels is provided or not
+    cmpInfo->tile_size = COMPARE_DEFAULT_TILE;
+    if (argv[4] != NULL)
+    {
+        int tile_size = atoi(argv[4]);
+        if (tile_size <= 0 || tile_size > COMPARE_MAX_TILE)
+        {
+            printf("INFO : Please mention tile size in pixels correctly Eg:64\n");
+            return e_failure;
+        }
+        cmpInfo->tile_size = tile_size;
+    }
+    // checks if changed bit bitmap file is provided or not
+    if (argv[4] != NULL && argv[5] != NULL)
+        cmpInfo->bitmap_fname = argv[5];
+    cmpInfo->placement = e_place_node;
+    fsync_policy_default_single(&cmpInfo->fsync_policy);
+    return e_success;
+}
+
+/* Read headers of both images
+ * Input: cmpInfo with both images opened
+ * Output: Pixel data size, dimensions and bytes per pixel are stored in
+ * cmpInfo. Pixel data is the rows of the image, padding included, inside the
+ * pixel span
+ * Description: Headers are parsed by the carrier formats, taken from the carrier cache
+ * Return: e_success or e_failure, if the images differ in format, size or layout
+ */
+Status read_compare_headers(CompareInfo *cmpInfo)
+{
+    CarrierInfo stego;
+    if (carrier_cache_get(cmpInfo->fptr_carrier, &cmpInfo->carrier) != e_success || carrier_cache_get(cmpInfo->fptr_stego, &stego) != e_success)
+        return e_failure;
+    CarrierInfo *carrier = &cmpInfo->carrier;
+    if (carrier->format != stego.format || carrier->size != stego.size || carrier->width != stego.width || carrier->height != stego.height ||
+        carrier->bits_per_pixel != stego.bits_per_pixel || carrier->pixel_offset != stego.pixel_offset || carrier->stride != stego.stride)
+    {
+        printf("INFO : Images differ in format, size or layout\n");
+        return e_failure;
+    }
+    cmpInfo->width = llabs(carrier->width);
+    cmpInfo->height = llabs(carrier->height);
+    cmpInfo->bytes_per_pixel = carrier->bits_per_pixel / 8;
+    if (cmpInfo->width == 0 || cmpInfo->height == 0 || cmpInfo->bytes_per_pixel == 0 || carrier->stride == 0)
+        return e_failure;
+    cmpInfo->pixel_size = (uint64_t)carrier->stride * cmpInfo->height;
+    if (cmpInfo->pixel_size > carrier->pixel_end - carrier->pixel_offset)
+        cmpInfo->pixel_size = carrier->pixel_end - carrier->pixel_offset;
+    return e_success;
+}
+
+/* Count differences of one byte
+ * Inputs: Bytes of both buffers and the counters of a chunk
+ * Description: Difference fits 16 bits so its square is a 16 bit multiply
+ * add, bits of the xor are counted by halving as in a popcount
+ */
+static inline void compare_byte(unsigned char x, unsigned char y, int32_t *squares, uint16_t *changed, uint16_t *bits)
+{
+    int16_t diff = x - y;
+    unsigned char d = x ^ y;
+    *squares += diff * diff;
+    *changed += d != 0;
+    d = d - ((d >> 1) & 0x55);
+    d = (d & 0x33) + ((d >> 2) & 0x33);
+    *bits += (d + (d >> 4)) & 0x0F;
+}
+
+/* Compare bytes
+ * Inputs: Two buffers, their size and counts
+ * Output: Sum of squared differences, changed bytes and changed bits are
+ * added to counts
+ * Description: Each chunk is counted in narrow lanes, which can not overflow
+ * in COMPARE_CHUNK bytes, by a loop of COMPARE_LANES bytes with no branches
+ * that the compiler turns into SIMD code at -O2
+ */
+void compare_bytes(const unsigned char *a, const unsigned char *b, size_t size, CompareCounts *counts)
+{
+    for (size_t pos = 0; pos < size; pos += COMPARE_CHUNK)
+    {
+        size_t len = size - pos < COMPARE_CHUNK ? size - pos : COMPARE_CHUNK;
+        const unsigned char *x = a + pos, *y = b + pos;
+        int32_t squares = 0;
+        uint16_t changed = 0, bits = 0;
+        size_t i = 0;
+        for (; i + COMPARE_LANES <= len; i += COMPARE_LANES)
+        {
+            for (uint j = 0; j < COMPARE_LANES; j++)
+                compare_byte(x[i + j], y[i + j], &squares, &changed, &bits);
+        }
+        for (; i < len; i++)
+            compare_byte(x[i], y[i], &squares, &changed, &bits);
+        counts->sum_squares += squares;
+        counts->changed_bytes += changed;
+        counts->changed_bits += bits;
+    }
+}
+
+/* Make changed bit bitmap
+ * Inputs: Two buffers, their size and bitmap of (size + 7) / 8 bytes
+ * Output: Bit i, MSB first as bits are embedded, is set if byte i differs
+ * Description: 64 bytes are compared to 0 or 1 flags at a time, then each 8
+ * flags, loaded as a little endian word, are packed into a bitmap byte with
+ * one multiply, byte 0 landing in the top bit. Big endian hosts go byte
+ * by byte
+ */
+void compare_bitmap(const unsigned char *a, const unsigned char *b, size_t size, unsigned char *bitmap)
+{
+    size_t i = 0;
+    // packing reads flag k of a word as its byte k in memory, only so on little endian hosts
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    unsigned char flags[64];
+    for (; i + sizeof(flags) <= size; i += sizeof(flags))
+    {
+        for (uint j = 0; j < sizeof(flags); j++)
+            flags[j] = a[i + j] != b[i + j];
+        for (uint j = 0; j < sizeof(flags) / 8; j++)
+        {
+            uint64_t word;
+            memcpy(&word, flags + 8 * j, sizeof(word));
+            bitmap[i / 8 + j] = (word * 0x8040201008040201ULL) >> 56;
+        }
+    }
+#endif
+    for (; i < size; i++)
+    {
+        if (i % 8 == 0)
+            bitmap[i / 8] = 0;
+        bitmap[i / 8] |= (a[i] != b[i]) << (7 - i % 8);
+    }
+}
+
+/* Read a range of a file
+ * Inputs: File descriptor, buffer, size and offset
+ * Return Value: e_success or e_failure, if the range could not be read whole
+ */
+static Status compare_read(int fd, unsigned char *buffer, size_t size, uint64_t offset)
+{
+    for (size_t done = 0; done < size;)
+    {
+        ssize_t n = pread(fd, buffer + done, size - done, offset + done);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return e_failure;
+        done += n;
+    }
+    return e_success;
+}
+
+/* Compare pixel bytes tile by tile
+ * Inputs: cmpInfo, both buffers, their offset in the pixel data, size and counts
+ * Output: Buffers are split where rows and tiles end, changed bytes of each
+ * part are added to its tile and all differences to counts. Row padding
+ * counts for the last tile of its row
+ */
+static void compare_tiles(CompareInfo *cmpInfo, const unsigned char *a, const unsigned char *b, uint64_t offset, size_t size,
+                          CompareCounts *counts)
+{
+    uint64_t stride = cmpInfo->carrier.stride;
+    uint64_t row_bytes = cmpInfo->width * cmpInfo->bytes_per_pixel;
+    uint64_t tile_bytes = (uint64_t)cmpInfo->tile_size * cmpInfo->bytes_per_pixel;
+    for (uint64_t pos = offset, end = offset + size; pos < end;)
+    {
+        uint64_t row = pos / stride, in_row = pos % stride;
+        uint64_t tile_x, part_end;
+        if (in_row < row_bytes)
+        {
+            tile_x = in_row / tile_bytes;
+            part_end = pos - in_row + ((tile_x + 1) * tile_bytes < row_bytes ? (tile_x + 1) * tile_bytes : row_bytes);
+        }
+        else
+        {
+            tile_x = cmpInfo->tiles_x - 1;
+            part_end = pos - in_row + stride;
+        }
+        if (part_end > end)
+            part_end = end;
+        CompareCounts part = {0, 0, 0};
+        compare_bytes(a + (pos - offset), b + (pos - offset), part_end - pos, &part);
+        cmpInfo->tile_changed[row / cmpInfo->tile_size * cmpInfo->tiles_x + tile_x] += part.changed_bytes;
+        counts->sum_squares += part.sum_squares;
+        counts->changed_bytes += part.changed_bytes;
+        counts->changed_bits += part.changed_bits;
+        pos = part_end;
+    }
+}
+
+/* Compare one stripe
+ * Inputs: cmpInfo, stripe index and id of the worker running it
+ * Output: Counts of the stripe and changes of its tiles are stored in
+ * cmpInfo, and its part of the bitmap is written. Both images are read once
+ * in blocks from the shared block pool
+ */
+void compare_stripe(void *arg, long stripe, uint worker_id)
+{
+    CompareInfo *cmpInfo = arg;
+    uint64_t stripe_bytes = cmpInfo->stripe_rows * cmpInfo->carrier.stride;
+    uint64_t start = stripe * stripe_bytes;
+    uint64_t end = start + stripe_bytes < cmpInfo->pixel_size ? start + stripe_bytes : cmpInfo->pixel_size;
+    int fd_carrier = fileno(cmpInfo->fptr_carrier), fd_stego = fileno(cmpInfo->fptr_stego);
+
+    unsigned char *carrier_block = (unsigned char *)block_pool_get(shared_block_pool());
+    unsigned char *stego_block = (unsigned char *)block_pool_get(shared_block_pool());
+    unsigned char *bitmap = cmpInfo->fptr_bitmap != NULL ? (unsigned char *)block_pool_get(shared_block_pool()) : NULL;
+    if (carrier_block == NULL || stego_block == NULL || (cmpInfo->fptr_bitmap != NULL && bitmap == NULL))
+        cmpInfo->error = 1;
+    // stripes and blocks start at a multiple of 8 bytes, so each fills whole bitmap bytes
+    for (uint64_t offset = start; offset < end && !cmpInfo->error; offset += IO_BLOCK_SIZE)
+    {
+        size_t len = end - offset < IO_BLOCK_SIZE ? end - offset : IO_BLOCK_SIZE;
+        uint64_t file_offset = cmpInfo->carrier.pixel_offset + offset;
+        if (compare_read(fd_carrier, carrier_block, len, file_offset) != e_success ||
+            compare_read(fd_stego, stego_block, len, file_offset) != e_success)
+        {
+            cmpInfo->error = 1;
+            break;
+        }
+        compare_tiles(cmpInfo, carrier_block, stego_block, offset, len, &cmpInfo->stripes[stripe]);
+        if (bitmap != NULL)
+        {
+            compare_bitmap(carrier_block, stego_block, len, bitmap);
+            if (pwrite(fileno(cmpInfo->fptr_bitmap), bitmap, (len + 7) / 8, offset / 8) != (ssize_t)((len + 7) / 8))
+                cmpInfo->error = 1;
+        }
+    }
+    if (carrier_block != NULL)
+        block_pool_put(shared_block_pool(), (char *)carrier_block);
+    if (stego_block != NULL)
+        block_pool_put(shared_block_pool(), (char *)stego_block);
+    if (bitmap != NULL)
+        block_pool_put(shared_block_pool(), (char *)bitmap);
+    worker_pool_add_bytes(&cmpInfo->pool, worker_id, 2 * (end - start));
+}
+
+/* Compare bytes outside the pixel data
+ * Inputs: cmpInfo, range of file offsets and counts
+ * Output: Differences of the range are added to counts
+ * Return Value: e_success or e_failure
+ */
+static Status compare_range(CompareInfo *cmpInfo, uint64_t start, uint64_t end, CompareCounts *counts)
+{
+    unsigned char *carrier_block = (unsigned char *)block_pool_get(shared_block_pool());
+    unsigned char *stego_block = (unsigned char *)block_pool_get(shared_block_pool());
+    Status status = carrier_block != NULL && stego_block != NULL ? e_success : e_failure;
+    for (uint64_t offset = start; offset < end && status == e_success; offset += IO_BLOCK_SIZE)
+    {
+        size_t len = end - offset < IO_BLOCK_SIZE ? end - offset : IO_BLOCK_SIZE;
+        status = compare_read(fileno(cmpInfo->fptr_carrier), carrier_block, len, offset);
+        if (status == e_success)
+            status = compare_read(fileno(cmpInfo->fptr_stego), stego_block, len, offset);
+        if (status == e_success)
+            compare_bytes(carrier_block, stego_block, len, counts);
+    }
+    if (carrier_block != NULL)
+        block_pool_put(shared_block_pool(), (char *)carrier_block);
+    if (stego_block != NULL)
+        block_pool_put(shared_block_pool(), (char *)stego_block);
+    return status;
+}
+
+/* Print tile changes
+ * Input: cmpInfo with the tiles compared
+ * Output: Changed tiles and highest density are printed, and for images up
+ * to COMPARE_MAP_MAX_TILES tiles wide a map with one character per tile,
+ * . for no change, else tenths of the tile bytes changed, rows in file order
+ */
+static void compare_print_tiles(CompareInfo *cmpInfo)
+{
+    uint64_t changed_tiles = 0;
+    double max_density = 0;
+    int print_map = cmpInfo->tiles_x <= COMPARE_MAP_MAX_TILES;
+    char map[COMPARE_MAP_MAX_TILES + 1];
+    if (print_map)
+        printf("INFO : Tile map of %ux%u pixel tiles, . unchanged, 0-9 tenths of bytes changed\n", cmpInfo->tile_size, cmpInfo->tile_size);
+    for (uint64_t ty = 0; ty < cmpInfo->tiles_y; ty++)
+    {
+        uint64_t rows = cmpInfo->height - ty * cmpInfo->tile_size < cmpInfo->tile_size ? cmpInfo->height - ty * cmpInfo->tile_size : cmpInfo->tile_size;
+        for (uint64_t tx = 0; tx < cmpInfo->tiles_x; tx++)
+        {
+            uint64_t cols = cmpInfo->width - tx * cmpInfo->tile_size < cmpInfo->tile_size ? cmpInfo->width - tx * cmpInfo->tile_size : cmpInfo->tile_size;
+            uint64_t changed = cmpInfo->tile_changed[ty * cmpInfo->tiles_x + tx];
+            // padding of the last tile is not counted in its bytes
+            double density = (double)changed / (rows * cols * cmpInfo->bytes_per_pixel);
+            if (density > 1)
+                density = 1;
+            if (changed > 0)
+                changed_tiles++;
+            if (density > max_density)
+                max_density = density;
+            if (print_map)
+                map[tx] = changed == 0 ? '.' : '0' + (density * 10 < 9 ? (int)(density * 10) : 9);
+        }
+        if (print_map)
+        {
+            map[cmpInfo->tiles_x] = '\0';
+            printf("INFO : Tile row %4llu %s\n", (unsigned long long)ty, map);
+        }
+    }
+    printf("INFO : Changed tiles %llu of %llu, highest density %.1f%%\n", (unsigned long long)changed_tiles,
+           (unsigned long long)(cmpInfo->tiles_x * cmpInfo->tiles_y), max_density * 100);
+}
+
+/* Close files of a comparison
+ * Input: cmpInfo
+ * Output: Images are closed and buffers freed, an unfinished bitmap is removed
+ */
+static void compare_close(CompareInfo *cmpInfo)
+{
+    if (cmpInfo->fptr_bitmap != NULL)
+        durable_abort(&cmpInfo->bitmap_file, cmpInfo->fptr_bitmap);
+    cmpInfo->fptr_bitmap = NULL;
+    if (cmpInfo->fptr_carrier != NULL)
+        fclose(cmpInfo->fptr_carrier);
+    if (cmpInfo->fptr_stego != NULL)
+        fclose(cmpInfo->fptr_stego);
+    free(cmpInfo->tile_changed);
+    free(cmpInfo->stripes);
+}
+
+/* Do compare function
+ * Inputs: cmpInfo
+ * Output: Stripes are compared in parallel, MSE, PSNR, changed bytes and
+ * bits, bytes changed outside the pixel data and tile changes are printed,
+ * and the changed bit bitmap is written if asked for
+ * Return Value: e_success or e_failure
+ */
+Status do_compare(CompareInfo *cmpInfo)
+{
+    cmpInfo->fptr_carrier = fopen(cmpInfo->carrier_fname, "r");
+    cmpInfo->fptr_stego = fopen(cmpInfo->stego_fname, "r");
+    if (cmpInfo->fptr_carrier == NULL || cmpInfo->fptr_stego == NULL)
+    {
+        perror("fopen ");
+        fprintf(stderr, "ERROR : Unable to open file %s\n", cmpInfo->fptr_carrier == NULL ? cmpInfo->carrier_fname : cmpInfo->stego_fname);
+        compare_close(cmpInfo);
+        return e_failure;
+    }
+    if (read_compare_headers(cmpInfo) == e_success)
+    {
+        printf("INFO : Reading image headers successful\n");
+    }
+    else
+    {
+        printf("ERROR : Reading image headers failed\n");
+        compare_close(cmpInfo);
+        return e_failure;
+    }
+
+    // stripes hold whole tile rows and start at a multiple of 8 bytes, for the bitmap
+    uint64_t tile_rows = 1;
+    while (tile_rows < 8 && tile_rows * cmpInfo->tile_size * cmpInfo->carrier.stride % 8 != 0)
+        tile_rows *= 2;
+    cmpInfo->stripe_rows = tile_rows * cmpInfo->tile_size;
+    cmpInfo->num_stripes = (cmpInfo->height + cmpInfo->stripe_rows - 1) / cmpInfo->stripe_rows;
+    cmpInfo->tiles_x = (cmpInfo->width + cmpInfo->tile_size - 1) / cmpInfo->tile_size;
+    cmpInfo->tiles_y = (cmpInfo->height + cmpInfo->tile_size - 1) / cmpInfo->tile_size;
+    cmpInfo->tile_changed = calloc(cmpInfo->tiles_x * cmpInfo->tiles_y, sizeof(uint64_t));
+    cmpInfo->stripes = calloc(cmpInfo->num_stripes, sizeof(CompareCounts));
+    if (cmpInfo->tile_changed == NULL || cmpInfo->stripes == NULL)
+    {
+        printf("ERROR : Getting tile counters failed\n");
+        compare_close(cmpInfo);
+        return e_failure;
+    }
+    if (cmpInfo->bitmap_fname != NULL)
+    {
+        cmpInfo->fptr_bitmap = durable_open(&cmpInfo->bitmap_file, cmpInfo->bitmap_fname);
+        if (cmpInfo->fptr_bitmap == NULL)
+        {
+            perror("fopen ");
+            fprintf(stderr, "ERROR : Unable to open file %s\n", cmpInfo->bitmap_fname);
+            compare_close(cmpInfo);
+            return e_failure;
+        }
+    }
+
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    cmpInfo->num_workers = online > 0 ? online : 1;
+    if (worker_pool_start(&cmpInfo->pool, cmpInfo->num_workers, cmpInfo->placement) != e_success)
+    {
+        printf("ERROR : Starting compare workers failed\n");
+        compare_close(cmpInfo);
+        return e_failure;
+    }
+    printf("INFO : Comparing %llu stripes of %llu rows on %u workers, %u nodes, placement %s\n", (unsigned long long)cmpInfo->num_stripes,
+           (unsigned long long)cmpInfo->stripe_rows, cmpInfo->num_workers, cmpInfo->pool.placement.num_nodes,
+           placement_policy_name(cmpInfo->placement));
+    uint64_t start_ns = worker_pool_now_ns();
+    for (uint64_t s = 0; s < cmpInfo->num_stripes; s++)
+        worker_pool_submit(&cmpInfo->pool, compare_stripe, cmpInfo, s, 1);
+    worker_pool_wait_idle(&cmpInfo->pool);
+    uint64_t elapsed_ns = worker_pool_now_ns() - start_ns;
+    WorkerPoolStats pool_stats;
+    worker_pool_get_stats(&cmpInfo->pool, &pool_stats);
+    worker_pool_stop(&cmpInfo->pool);
+    for (uint i = 0; i < pool_stats.num_nodes; i++)
+    {
+        WorkerNodeStats *node = &pool_stats.nodes[i];
+        // bytes per ns * 1000 is MB/s
+        printf("INFO : Node %d compared %llu stripes (%llu stolen) on %u workers at %.1f MB/s\n", node->node_id,
+               (unsigned long long)node->jobs_done, (unsigned long long)node->jobs_stolen, node->num_workers,
+               node->busy_ns ? node->bytes * 1000.0 / node->busy_ns : 0);
+    }
+
+    // header and bytes after the pixel data must not change
+    CompareCounts outside = {0, 0, 0};
+    uint64_t pixel_end = cmpInfo->carrier.pixel_offset + cmpInfo->pixel_size;
+    if (cmpInfo->error || compare_range(cmpInfo, 0, cmpInfo->carrier.pixel_offset, &outside) != e_success ||
+        compare_range(cmpInfo, pixel_end, cmpInfo->carrier.size, &outside) != e_success)
+    {
+        printf("ERROR : Reading image data failed\n");
+        compare_close(cmpInfo);
+        return e_failure;
+    }
+
+    CompareCounts total = {0, 0, 0};
+    for (uint64_t s = 0; s < cmpInfo->num_stripes; s++)
+    {
+        total.sum_squares += cmpInfo->stripes[s].sum_squares;
+        total.changed_bytes += cmpInfo->stripes[s].changed_bytes;
+        total.changed_bits += cmpInfo->stripes[s].changed_bits;
+    }
+    printf("INFO : Compared %llu bytes of pixel data in both images at %.1f MB/s\n", (unsigned long long)cmpInfo->pixel_size,
+           elapsed_ns ? 2 * cmpInfo->pixel_size * 1000.0 / elapsed_ns : 0);
+    printf("INFO : Changed bytes %llu (%.3f%%), changed bits %llu\n", (unsigned long long)total.changed_bytes,
+           cmpInfo->pixel_size ? total.changed_bytes * 100.0 / cmpInfo->pixel_size : 0, (unsigned long long)total.changed_bits);
+    double mse = cmpInfo->pixel_size ? (double)total.sum_squares / cmpInfo->pixel_size : 0;
+    if (total.sum_squares == 0)
+        printf("INFO : MSE 0 PSNR inf dB, pixel data is identical\n");
+    else
+        printf("INFO : MSE %.6f PSNR %.2f dB\n", mse, 10 * log10(255.0 * 255.0 / mse));
+    if (outside.changed_bytes > 0)
+        printf("INFO : Changed bytes outside the pixel data %llu, header or trailer differs\n", (unsigned long long)outside.changed_bytes);
+    else
+        printf("INFO : Header and trailer are identical\n");
+    compare_print_tiles(cmpInfo);
+
+    if (cmpInfo->fptr_bitmap != NULL)
+    {
+        Status status = durable_commit(&cmpInfo->bitmap_file, cmpInfo->fptr_bitmap, &cmpInfo->fsync_policy);
+        cmpInfo->fptr_bitmap = NULL;
+        if (status != e_success)
+        {
+            printf("ERROR : Writing changed bit bitmap %s failed\n", cmpInfo->bitmap_fname);
+            compare_close(cmpInfo);
+            return e_failure;
+        }
+        printf("INFO : Changed bit bitmap %s written, %llu bytes, one bit per pixel data byte\n", cmpInfo->bitmap_fname,
+               (unsigned long long)(cmpInfo->pixel_size + 7) / 8);
+    }
+    compare_close(cmpInfo);
+    return e_success;
+}
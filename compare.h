@@ -0,0 +1,92 @@
+#ifndef COMPARE_H
+#define COMPARE_H
+
+#include <stdio.h>
+#include "types.h" // Contains user defined types
+#include "carrier.h"
+#include "durable.h"
+#include "worker_pool.h"
+
+/*
+ * Structure to store information required for
+ * comparing a carrier with its stego image. The pixel
+ * data is split in stripes of whole tile rows which are
+ * compared in parallel, each read once. Bytes are compared
+ * with kernels over fixed size chunks that the compiler
+ * vectorizes, giving squared error, changed bytes and
+ * changed bits, and changes per tile
+ */
+
+#define COMPARE_DEFAULT_TILE 64
+#define COMPARE_MAX_TILE 4096
+/* Bytes per kernel chunk, its 16 bit counters and 32 bit sum of squares can not overflow */
+#define COMPARE_CHUNK 4096
+/* Bytes per iteration of the kernel loops, a multiple of the SIMD width */
+#define COMPARE_LANES 32
+/* Widest tile map printed, one character per tile */
+#define COMPARE_MAP_MAX_TILES 128
+
+/* Differences counted over a byte range */
+typedef struct _CompareCounts
+{
+    uint64_t sum_squares;
+    uint64_t changed_bytes;
+    uint64_t changed_bits;
+} CompareCounts;
+
+typedef struct _CompareInfo
+{
+    /* Images compared, both parsed by the carrier formats */
+    char *carrier_fname;
+    FILE *fptr_carrier;
+    char *stego_fname;
+    FILE *fptr_stego;
+    CarrierInfo carrier;
+    uint64_t pixel_size;
+    uint64_t width;
+    uint64_t height;
+    uint bytes_per_pixel;
+
+    /* Tiles of tile_size x tile_size pixels, changed bytes of each */
+    uint tile_size;
+    uint64_t tiles_x;
+    uint64_t tiles_y;
+    uint64_t *tile_changed;
+
+    /* Stripes compared in parallel */
+    uint64_t stripe_rows;
+    uint64_t num_stripes;
+    CompareCounts *stripes;
+    uint num_workers;
+    PlacementPolicy placement;
+    WorkerPool pool;
+    int error;
+
+    /* Changed bit bitmap, one bit per pixel byte, optional */
+    char *bitmap_fname;
+    FILE *fptr_bitmap;
+    DurableFile bitmap_file;
+    FsyncPolicy fsync_policy;
+} CompareInfo;
+
+/* Compare function prototype */
+
+/* Read and validate compare args from argv */
+Status read_and_validate_compare_args(char *argv[], CompareInfo *cmpInfo);
+
+/* Perform the comparison */
+Status do_compare(CompareInfo *cmpInfo);
+
+/* Read and check headers of both images */
+Status read_compare_headers(CompareInfo *cmpInfo);
+
+/* Compare one stripe, runs on a worker */
+void compare_stripe(void *arg, long stripe, uint worker_id);
+
+/* Count squared error, changed bytes and changed bits of two buffers */
+void compare_bytes(const unsigned char *a, const unsigned char *b, size_t size, CompareCounts *counts);
+
+/* Set a bit, MSB first, for every byte that differs */
+void compare_bitmap(const unsigned char *a, const unsigned char *b, size_t size, unsigned char *bitmap);
+
+#endif
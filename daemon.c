@@ -0,0 +1,613 @@
+// 64 bit file offsets so multi-GB carriers and payloads work
+#define _FILE_OFFSET_BITS 64
+// fmemopen
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include "daemon.h"
+#include "encode.h"
+#include "decode.h"
+#include "carrier_cache.h"
+#include "mem_pool.h"
+#include "types.h"
+
+/* Set from signal handler to stop accepting connections */
+static volatile sig_atomic_t daemon_stop_requested;
+
+/* Function Definitions */
+
+/* Signal handler for SIGINT and SIGTERM */
+static void daemon_signal_handler(int signum)
+{
+    (void)signum;
+    daemon_stop_requested = 1;
+}
+
+/* Send whole buffer on connection
+ * Inputs: Connection, buffer and size
+ * Return Value: e_success or e_failure
+ */
+static Status daemon_send(int conn, const char *buffer, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t n = send(conn, buffer, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return e_failure;
+        buffer += n;
+        size -= n;
+    }
+    return e_success;
+}
+
+/* Send a reply line
+ * Inputs: Worker and reply text
+ * Return Value: e_success or e_failure
+ */
+static Status daemon_reply(DaemonWorker *worker, const char *reply)
+{
+    return daemon_send(worker->conn, reply, strlen(reply));
+}
+
+/* Read and validate daemon arguments
+ * Input: Command line arguments and daemon
+ * Output: Socket path, number of workers and placement policy are stored in daemon
+ * Return: e_success or e_failure
+ */
+Status read_and_validate_daemon_args(char *argv[], DaemonInfo *daemon)
+{
+    struct sockaddr_un addr;
+    memset(daemon, 0, sizeof(*daemon));
+    // socket path should fit in sun_path
+    if (strlen(argv[2]) >= sizeof(addr.sun_path))
+    {
+        printf("INFO : Socket path %s is too long\n", argv[2]);
+        return e_failure;
+    }
+    daemon->socket_path = argv[2];
+    // checks if number of workers is provided or not
+    if (argv[3] != NULL)
+    {
+        int num_workers = atoi(argv[3]);
+        if (num_workers <= 0)
+        {
+            printf("INFO : Please mention number of workers correctly Eg:4\n");
+            return e_failure;
+        }
+        daemon->num_workers = num_workers;
+    }
+    else
+    {
+        daemon->num_workers = DAEMON_DEFAULT_WORKERS;
+    }
+    // checks if placement policy is provided or not
+    daemon->placement = e_place_node;
+    if (argv[3] != NULL && argv[4] != NULL && placement_parse_policy(argv[4], &daemon->placement) != e_success)
+    {
+        printf("INFO : Please mention placement policy correctly Eg:none, node or core\n");
+        return e_failure;
+    }
+    // outputs are synced by the policy of STEGO_FSYNC
+    fsync_policy_default(&daemon->fsync_policy);
+    return e_success;
+}
+
+/* Read request from connection
+ * Input: Worker with connection set
+ * Output: Request line is stored null terminated in worker->line, passed
+ * descriptors in worker->fds and bytes after the line in worker->data
+ * Return: e_success or e_failure, on socket errors, a line too long or more
+ * than DAEMON_MAX_FDS descriptors
+ */
+Status daemon_read_request(DaemonWorker *worker)
+{
+    size_t len = 0;
+    char *newline = NULL;
+    int too_many_fds = 0;
+    worker->num_fds = 0;
+    worker->data_len = 0;
+    while (newline == NULL)
+    {
+        if (len == DAEMON_LINE_MAX)
+            return e_failure;
+        char control[CMSG_SPACE(sizeof(int) * DAEMON_MAX_FDS)];
+        struct iovec iov = {.iov_base = worker->line + len, .iov_len = DAEMON_LINE_MAX - len};
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        ssize_t n = recvmsg(worker->conn, &msg, MSG_CMSG_CLOEXEC);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return e_failure;
+        // collects descriptors passed along with the data
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+                continue;
+            // alignment padding of control leaves room for more than DAEMON_MAX_FDS
+            uint count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (uint i = 0; i < count; i++)
+            {
+                int fd;
+                memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+                if (worker->num_fds < DAEMON_MAX_FDS)
+                {
+                    worker->fds[worker->num_fds++] = fd;
+                }
+                else
+                {
+                    close(fd);
+                    too_many_fds = 1;
+                }
+            }
+        }
+        // descriptors that did not fit control were closed by the kernel
+        if (msg.msg_flags & MSG_CTRUNC)
+            too_many_fds = 1;
+        len += n;
+        newline = memchr(worker->line, '\n', len);
+    }
+    // kept descriptors are closed by the caller
+    if (too_many_fds)
+        return e_failure;
+    // bytes after the line are the start of inline data
+    worker->data_len = len - (newline + 1 - worker->line);
+    memcpy(worker->data, newline + 1, worker->data_len);
+    *newline = '\0';
+    return e_success;
+}
+
+/* Read rest of inline data
+ * Inputs: Worker and total size of inline data
+ * Return: e_success or e_failure
+ */
+static Status daemon_read_data(DaemonWorker *worker, size_t size)
+{
+    if (worker->data_len > size)
+        return e_failure;
+    while (worker->data_len < size)
+    {
+        ssize_t n = recv(worker->conn, worker->data + worker->data_len, size - worker->data_len, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return e_failure;
+        worker->data_len += n;
+    }
+    return e_success;
+}
+
+/* Open passed descriptor as a stream
+ * Inputs: Worker, index of the descriptor and mode
+ * Output: Descriptor is owned by the returned stream
+ * Return: FILE pointer or NULL
+ */
+static FILE *daemon_fdopen(DaemonWorker *worker, uint index, const char *mode)
+{
+    FILE *fptr = fdopen(worker->fds[index], mode);
+    if (fptr != NULL)
+        worker->fds[index] = -1;
+    return fptr;
+}
+
+/* Close a stream if opened
+ * Input: File pointer
+ * Return: e_success or e_failure, if buffered data could not be written
+ */
+static Status daemon_fclose(FILE *fptr)
+{
+    if (fptr == NULL)
+        return e_success;
+    return fclose(fptr) == 0 ? e_success : e_failure;
+}
+
+/* Sync output by policy
+ * Inputs: Worker and output file pointer
+ * Output: Buffered data is written, a regular file is synced by the fsync
+ * policy of the daemon. Pipes and sockets are not synced
+ * Return: e_success or e_failure
+ */
+static Status daemon_sync_output(DaemonWorker *worker, FILE *fptr)
+{
+    struct stat st;
+    if (fflush(fptr) != 0)
+        return e_failure;
+    if (fstat(fileno(fptr), &st) != 0 || !S_ISREG(st.st_mode))
+        return e_success;
+    return durable_sync_fd(fileno(fptr), worker->fsync_policy);
+}
+
+/* Serve encode request
+ * Inputs: Worker and request arguments after the command
+ * Output: Secret from a descriptor or inline data is encoded to the output descriptor
+ * Return: e_success or e_failure
+ */
+Status daemon_encode(DaemonWorker *worker, char *args)
+{
+    char extn[DAEMON_LINE_MAX];
+    unsigned long long size = 0;
+    int num_args = sscanf(args, "%s %llu", extn, &size);
+    // extension along with null character should fit in extn_secret_file
+    if (num_args < 1 || extn[0] != '.' || strlen(extn) >= MAX_FILE_SUFFIX)
+    {
+        daemon_reply(worker, "ERR bad extension\n");
+        return e_failure;
+    }
+    if ((num_args == 1 && worker->num_fds != 3) || (num_args == 2 && worker->num_fds != 2))
+    {
+        daemon_reply(worker, "ERR wrong number of descriptors\n");
+        return e_failure;
+    }
+    if (num_args == 2 && (size > DAEMON_INLINE_MAX || daemon_read_data(worker, size) != e_success))
+    {
+        daemon_reply(worker, "ERR bad inline data\n");
+        return e_failure;
+    }
+
+    EncodeInfo encInfo;
+    memset(&encInfo, 0, sizeof(encInfo));
+    encInfo.src_image_fname = "carrier";
+    encInfo.secret_fname = extn;
+    encInfo.stego_image_fname = "output";
+    encInfo.fptr_src_image = daemon_fdopen(worker, 0, "r");
+    if (num_args == 2)
+    {
+        encInfo.fptr_secret = fmemopen(worker->data, size, "r");
+        encInfo.fptr_stego_image = daemon_fdopen(worker, 1, "w");
+    }
+    else
+    {
+        encInfo.fptr_secret = daemon_fdopen(worker, 1, "r");
+        encInfo.fptr_stego_image = daemon_fdopen(worker, 2, "w");
+    }
+
+    Status status = e_failure;
+    const char *error = "ERR encoding failed\n";
+    if (encInfo.fptr_src_image != NULL && encInfo.fptr_secret != NULL && encInfo.fptr_stego_image != NULL)
+    {
+        struct stat st;
+        // pipes and sockets take no positioned writes, the stego image is streamed to them
+        if (lseek(fileno(encInfo.fptr_stego_image), 0, SEEK_CUR) >= 0)
+            status = do_encoding_with_files(&encInfo);
+        else if (num_args == 1)
+            status = do_encoding_to_stream(&encInfo);
+        else
+        {
+            // the stego reader preads the secret, an inline secret has no descriptor
+            error = "ERR inline secret needs a seekable output\n";
+        }
+        if (encInfo.carrier.size == 0 && fstat(fileno(encInfo.fptr_src_image), &st) == 0)
+            encInfo.carrier.size = st.st_size;
+    }
+    if (status == e_success && daemon_sync_output(worker, encInfo.fptr_stego_image) != e_success)
+        status = e_failure;
+    worker->bytes = encInfo.carrier.size;
+    worker->heap_calls = encInfo.heap_calls;
+    daemon_fclose(encInfo.fptr_src_image);
+    daemon_fclose(encInfo.fptr_secret);
+    if (daemon_fclose(encInfo.fptr_stego_image) != e_success)
+        status = e_failure;
+    daemon_reply(worker, status == e_success ? "OK\n" : error);
+    return status;
+}
+
+/* Serve decode request
+ * Input: Worker
+ * Output: Secret is decoded to the output descriptor, or sent back inline
+ * Return: e_success or e_failure
+ */
+Status daemon_decode(DaemonWorker *worker)
+{
+    if (worker->num_fds != 1 && worker->num_fds != 2)
+    {
+        daemon_reply(worker, "ERR wrong number of descriptors\n");
+        return e_failure;
+    }
+    DecodeInfo decInfo;
+    memset(&decInfo, 0, sizeof(decInfo));
+    decInfo.stego_image_fname = "stego";
+    // output name is set so no default output file is created
+    decInfo.output_fname = "output";
+    decInfo.fptr_stego_image = daemon_fdopen(worker, 0, "r");
+    if (worker->num_fds == 2)
+        decInfo.fptr_output = daemon_fdopen(worker, 1, "w");
+    else
+    {
+        decInfo.fptr_output = fmemopen(worker->data, DAEMON_INLINE_MAX + 1, "w");
+        decInfo.output_limit = DAEMON_INLINE_MAX;
+    }
+
+    Status status = e_failure;
+    struct stat st;
+    if (decInfo.fptr_stego_image != NULL && decInfo.fptr_output != NULL)
+        status = do_decoding_with_files(&decInfo);
+    if (status == e_success && worker->num_fds == 2 && daemon_sync_output(worker, decInfo.fptr_output) != e_success)
+        status = e_failure;
+    if (decInfo.fptr_stego_image != NULL && fstat(fileno(decInfo.fptr_stego_image), &st) == 0)
+        worker->bytes = st.st_size;
+    worker->heap_calls = decInfo.heap_calls;
+    // inline reply is limited to the worker buffer, the size is decoded before any data
+    if (status != e_success && decInfo.output_limit != 0 && decInfo.size_image_data > decInfo.output_limit)
+    {
+        daemon_fclose(decInfo.fptr_stego_image);
+        daemon_fclose(decInfo.fptr_output);
+        daemon_reply(worker, "ERR secret too large for inline reply\n");
+        return e_failure;
+    }
+    daemon_fclose(decInfo.fptr_stego_image);
+    if (daemon_fclose(decInfo.fptr_output) != e_success)
+        status = e_failure;
+    if (status != e_success)
+    {
+        daemon_reply(worker, "ERR decoding failed\n");
+        return e_failure;
+    }
+
+    char reply[64];
+    sprintf(reply, "OK %llu\n", (unsigned long long)decInfo.size_image_data);
+    if (daemon_reply(worker, reply) != e_success)
+        return e_failure;
+    if (worker->num_fds == 1)
+        return daemon_send(worker->conn, worker->data, decInfo.size_image_data);
+    return e_success;
+}
+
+/* Serve probe request
+ * Input: Worker
+ * Output: Capacity and, if stegged, header fields of the image are sent back
+ * Return: e_success or e_failure
+ */
+Status daemon_probe(DaemonWorker *worker)
+{
+    if (worker->num_fds != 1)
+    {
+        daemon_reply(worker, "ERR wrong number of descriptors\n");
+        return e_failure;
+    }
+    DecodeInfo decInfo;
+    memset(&decInfo, 0, sizeof(decInfo));
+    decInfo.fptr_stego_image = daemon_fdopen(worker, 0, "r");
+    if (decInfo.fptr_stego_image == NULL)
+    {
+        daemon_reply(worker, "ERR bad descriptor\n");
+        return e_failure;
+    }
+    if (decode_alloc_buffers(&decInfo) != e_success)
+    {
+        daemon_fclose(decInfo.fptr_stego_image);
+        daemon_reply(worker, "ERR out of memory\n");
+        return e_failure;
+    }
+    CarrierInfo carrier;
+    if (carrier_cache_get(decInfo.fptr_stego_image, &carrier) != e_success)
+    {
+        daemon_fclose(decInfo.fptr_stego_image);
+        daemon_reply(worker, "ERR bad image\n");
+        return e_failure;
+    }
+
+    char reply[DAEMON_LINE_MAX];
+    unsigned long long capacity = carrier.capacity;
+    // header fields are only decoded from images the cache found stegged
+    if (carrier.stegged && decode_magic_string(&decInfo) == e_success && decode_stego_version(&decInfo) == e_success &&
+        decode_file_extn_size(&decInfo) == e_success && decode_file_extn(decInfo.size_image_data, &decInfo) == e_success &&
+        decode_file_size(&decInfo) == e_success)
+    {
+        sprintf(reply, "OK stegged=1 version=%u extn=%s size=%llu capacity=%llu\n", decInfo.version, decInfo.extn_output_file,
+                (unsigned long long)decInfo.size_image_data, capacity);
+    }
+    else
+    {
+        sprintf(reply, "OK stegged=0 capacity=%llu\n", capacity);
+    }
+    daemon_fclose(decInfo.fptr_stego_image);
+    return daemon_reply(worker, reply);
+}
+
+/* Serve stats request
+ * Inputs: daemon and worker
+ * Output: Queue depth, job counts and latencies are sent back, followed by
+ * workers, jobs, stolen jobs and MB/s while busy of each node
+ * Return: e_success or e_failure
+ */
+Status daemon_stats(DaemonInfo *daemon, DaemonWorker *worker)
+{
+    if (worker->num_fds != 0)
+    {
+        daemon_reply(worker, "ERR wrong number of descriptors\n");
+        return e_failure;
+    }
+    WorkerPoolStats stats;
+    char reply[DAEMON_STATS_MAX];
+    uint64_t cache_hits, cache_misses;
+    worker_pool_get_stats(&daemon->pool, &stats);
+    carrier_cache_stats(&cache_hits, &cache_misses);
+    uint64_t jobs = stats.jobs_done ? stats.jobs_done : 1;
+    int len = snprintf(reply, sizeof(reply), "OK workers=%u queued=%u max_queued=%u active=%u done=%llu failed=%llu rejected=%llu avg_wait_us=%.1f avg_latency_us=%.1f max_latency_us=%.1f pool_allocs=%llu hot_heap_calls=%llu cache_hits=%llu cache_misses=%llu placement=%s",
+            stats.num_workers, stats.queued, stats.max_queued, stats.active, (unsigned long long)stats.jobs_done,
+            (unsigned long long)__atomic_load_n(&daemon->jobs_failed, __ATOMIC_RELAXED),
+            (unsigned long long)__atomic_load_n(&daemon->jobs_rejected, __ATOMIC_RELAXED),
+            stats.wait_ns_total / 1000.0 / jobs, stats.latency_ns_total / 1000.0 / jobs, stats.latency_ns_max / 1000.0,
+            (unsigned long long)mem_pool_allocs(), (unsigned long long)__atomic_load_n(&daemon->hot_heap_calls, __ATOMIC_RELAXED),
+            (unsigned long long)cache_hits, (unsigned long long)cache_misses,
+            placement_policy_name(stats.policy));
+    for (uint i = 0; i < stats.num_nodes && len > 0 && (size_t)len < sizeof(reply); i++)
+    {
+        WorkerNodeStats *node = &stats.nodes[i];
+        // bytes per ns * 1000 is MB/s
+        double mb_s = node->busy_ns ? node->bytes * 1000.0 / node->busy_ns : 0;
+        len += snprintf(reply + len, sizeof(reply) - len, " node%d_workers=%u node%d_jobs=%llu node%d_stolen=%llu node%d_mb_s=%.1f",
+                        node->node_id, node->num_workers, node->node_id, (unsigned long long)node->jobs_done, node->node_id,
+                        (unsigned long long)node->jobs_stolen, node->node_id, mb_s);
+    }
+    if (len > 0 && (size_t)len < sizeof(reply) - 1)
+        strcpy(reply + len, "\n");
+    return daemon_reply(worker, reply);
+}
+
+/* Serve one connection
+ * Inputs: daemon, connection and id of the worker running it
+ * Output: Request is read, served and the connection closed
+ */
+void daemon_handle_connection(void *arg, long conn, uint worker_id)
+{
+    DaemonInfo *daemon = arg;
+    DaemonWorker *worker = &daemon->workers[worker_id];
+    Status status = e_failure;
+    worker->conn = conn;
+    worker->bytes = 0;
+    worker->heap_calls = 0;
+    if (daemon_read_request(worker) == e_success)
+    {
+        // splits command from its arguments
+        char *args = worker->line + strcspn(worker->line, " ");
+        if (*args != '\0')
+            *args++ = '\0';
+        if (strcmp(worker->line, "ENCODE") == 0)
+            status = daemon_encode(worker, args);
+        else if (strcmp(worker->line, "DECODE") == 0)
+            status = daemon_decode(worker);
+        else if (strcmp(worker->line, "PROBE") == 0)
+            status = daemon_probe(worker);
+        else if (strcmp(worker->line, "STATS") == 0)
+            status = daemon_stats(daemon, worker);
+        else
+            daemon_reply(worker, "ERR unknown command\n");
+    }
+    else
+    {
+        daemon_reply(worker, "ERR bad request\n");
+    }
+    // closes descriptors not handed over to a stream
+    for (uint i = 0; i < worker->num_fds; i++)
+    {
+        if (worker->fds[i] >= 0)
+            close(worker->fds[i]);
+    }
+    close(conn);
+    worker_pool_add_bytes(&daemon->pool, worker_id, worker->bytes);
+    __atomic_fetch_add(&daemon->hot_heap_calls, worker->heap_calls, __ATOMIC_RELAXED);
+    if (status != e_success)
+        __atomic_fetch_add(&daemon->jobs_failed, 1, __ATOMIC_RELAXED);
+}
+
+/* Do daemon function
+ * Input: daemon
+ * Output: Listens on the socket and hands connections to the worker pool,
+ * replies BUSY when the queue is full
+ * Return Value: e_success or e_failure
+ */
+Status do_daemon(DaemonInfo *daemon)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, daemon->socket_path);
+
+    daemon->listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (daemon->listen_fd < 0)
+    {
+        perror("socket ");
+        return e_failure;
+    }
+    // removes stale socket left by an earlier run, anything else at the path is kept
+    struct stat st;
+    if (lstat(daemon->socket_path, &st) == 0)
+    {
+        if (!S_ISSOCK(st.st_mode))
+        {
+            printf("ERROR : %s exists and is not a socket\n", daemon->socket_path);
+            close(daemon->listen_fd);
+            return e_failure;
+        }
+        unlink(daemon->socket_path);
+    }
+    if (bind(daemon->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(daemon->listen_fd, WORK_QUEUE_SIZE) != 0)
+    {
+        perror("bind ");
+        close(daemon->listen_fd);
+        return e_failure;
+    }
+
+    // per worker buffers are allocated once, up front
+    daemon->workers = calloc(daemon->num_workers, sizeof(DaemonWorker));
+    if (daemon->workers == NULL)
+    {
+        close(daemon->listen_fd);
+        unlink(daemon->socket_path);
+        return e_failure;
+    }
+    for (uint i = 0; i < daemon->num_workers; i++)
+    {
+        daemon->workers[i].data = mem_alloc_aligned(DAEMON_INLINE_MAX + 1);
+        daemon->workers[i].fsync_policy = &daemon->fsync_policy;
+        if (daemon->workers[i].data == NULL)
+            daemon->num_workers = 0;
+    }
+    if (daemon->num_workers == 0 || worker_pool_start(&daemon->pool, daemon->num_workers, daemon->placement) != e_success)
+    {
+        printf("ERROR : Starting workers failed\n");
+        for (uint i = 0; i < daemon->num_workers; i++)
+            mem_free(daemon->workers[i].data);
+        free(daemon->workers);
+        close(daemon->listen_fd);
+        unlink(daemon->socket_path);
+        return e_failure;
+    }
+
+    // accept is interrupted by SIGINT and SIGTERM
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = daemon_signal_handler;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("INFO : Daemon listening on %s with %u workers on %u nodes, placement %s\n", daemon->socket_path, daemon->num_workers,
+           daemon->pool.placement.num_nodes, placement_policy_name(daemon->placement));
+    Status status = e_success;
+    while (!daemon_stop_requested)
+    {
+        int conn = accept4(daemon->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (conn < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            perror("accept ");
+            status = e_failure;
+            break;
+        }
+        // back-pressure: full queue is reported instead of queueing more
+        if (worker_pool_submit(&daemon->pool, daemon_handle_connection, daemon, conn, 0) != e_success)
+        {
+            daemon_send(conn, "BUSY\n", 5);
+            close(conn);
+            __atomic_fetch_add(&daemon->jobs_rejected, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    printf("INFO : Daemon stopping, finishing queued requests\n");
+    close(daemon->listen_fd);
+    unlink(daemon->socket_path);
+    worker_pool_stop(&daemon->pool);
+    // outputs of the last, unfinished batch
+    durable_sync_pending();
+    for (uint i = 0; i < daemon->num_workers; i++)
+        mem_free(daemon->workers[i].data);
+    free(daemon->workers);
+    return status;
+}
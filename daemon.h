@@ -0,0 +1,103 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include "types.h" // Contains user defined types
+#include "worker_pool.h"
+#include "durable.h"
+
+/*
+ * Long running daemon serving encode, decode and probe
+ * requests over a Unix domain socket. One request per
+ * connection, a text line followed by optional inline data.
+ * Files are passed as descriptors with SCM_RIGHTS:
+ *
+ * ENCODE <extn>\n            fds: carrier, secret, output
+ * ENCODE <extn> <size>\n...  fds: carrier, output, secret sent inline
+ * DECODE\n                   fds: stego, output
+ * DECODE\n                   fds: stego, secret returned inline
+ * PROBE\n                    fds: image
+ * STATS\n
+ *
+ * Workers are placed on NUMA nodes by the placement
+ * policy, STATS reports jobs, steals and throughput of
+ * each node
+ *
+ * Output descriptors that are regular files are synced
+ * by the fsync policy of STEGO_FSYNC before the reply,
+ * a batch is counted over all requests of the daemon
+ *
+ * Replies are "OK ...\n" (followed by <size> bytes for
+ * inline decode), "ERR <reason>\n" or "BUSY\n" when the
+ * request queue is full
+ */
+
+#define DAEMON_MAX_FDS 3
+#define DAEMON_LINE_MAX 256
+#define DAEMON_INLINE_MAX (1 << 20)
+#define DAEMON_DEFAULT_WORKERS 4
+#define DAEMON_STATS_MAX 4096
+
+/* Buffers pre-allocated for each worker */
+typedef struct _DaemonWorker
+{
+    int conn;
+    char line[DAEMON_LINE_MAX + 1];
+    int fds[DAEMON_MAX_FDS];
+    uint num_fds;
+    char *data;
+    size_t data_len;
+    /* Image bytes processed by the request, for throughput */
+    uint64_t bytes;
+    /* Heap calls made by the request while embedding or extracting */
+    uint64_t heap_calls;
+    /* When outputs are synced, shared by all workers */
+    const FsyncPolicy *fsync_policy;
+} DaemonWorker;
+
+typedef struct _DaemonInfo
+{
+    /* Listening socket info */
+    char *socket_path;
+    int listen_fd;
+
+    /* Worker pool */
+    uint num_workers;
+    PlacementPolicy placement;
+    FsyncPolicy fsync_policy;
+    WorkerPool pool;
+    DaemonWorker *workers;
+
+    /* Stats not kept by the pool */
+    uint64_t jobs_failed;
+    uint64_t jobs_rejected;
+    /* Heap calls made while embedding or extracting, by all requests */
+    uint64_t hot_heap_calls;
+} DaemonInfo;
+
+/* Daemon function prototype */
+
+/* Read and validate daemon args from argv */
+Status read_and_validate_daemon_args(char *argv[], DaemonInfo *daemon);
+
+/* Run the daemon till SIGINT or SIGTERM */
+Status do_daemon(DaemonInfo *daemon);
+
+/* Read request line and passed file descriptors from a connection */
+Status daemon_read_request(DaemonWorker *worker);
+
+/* Serve one connection, runs on a worker */
+void daemon_handle_connection(void *arg, long conn, uint worker_id);
+
+/* Serve encode request */
+Status daemon_encode(DaemonWorker *worker, char *args);
+
+/* Serve decode request */
+Status daemon_decode(DaemonWorker *worker);
+
+/* Serve probe request */
+Status daemon_probe(DaemonWorker *worker);
+
+/* Serve stats request */
+Status daemon_stats(DaemonInfo *daemon, DaemonWorker *worker);
+
+#endif
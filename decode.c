@@ -1,6 +1,12 @@
+// 64 bit file offsets so multi-GB carriers and payloads work
+#define _FILE_OFFSET_BITS 64
+
 #include <stdio.h>
 #include <string.h>
 #include "decode.h"
+#include "carrier_cache.h"
+#include "mem_pool.h"
+#include "matrix.h"
 #include "types.h"
 #include "common.h"
 
@@ -13,8 +19,8 @@
  */
 Status read_and_validate_decode_args(char *argv[], DecodeInfo *decInfo)
 {
-    // Checks if 2nd argument passed is a .bmp file
-    if (strstr(argv[2], ".") != NULL && (strcmp(strstr(argv[2], "."), ".bmp") == 0))
+    // Checks if 2nd argument passed is a carrier image file, .bmp, .ppm, .pgm or .tga
+    if (carrier_format_by_name(argv[2]) != NULL)
     {
         // stores it in decInfo
         decInfo->stego_image_fname = argv[2];
@@ -25,11 +31,32 @@ Status read_and_validate_decode_args(char *argv[], DecodeInfo *decInfo)
         // returns failure
         return e_failure;
     }
+    // optional output filename and --direct and --fsync= flags, in any order
+    char *output = NULL;
+    decInfo->cache_mode = e_io_cached;
+    fsync_policy_default_single(&decInfo->fsync_policy);
+    for (uint i = 3; argv[i] != NULL; i++)
+    {
+        if (strcmp(argv[i], IO_DIRECT_FLAG) == 0)
+            decInfo->cache_mode = e_io_direct;
+        else if (strncmp(argv[i], FSYNC_FLAG, strlen(FSYNC_FLAG)) == 0)
+        {
+            // batches span the requests of the daemon, a run writes one output
+            if (fsync_policy_parse(argv[i] + strlen(FSYNC_FLAG), &decInfo->fsync_policy) != e_success ||
+                decInfo->fsync_policy.mode == e_fsync_batch)
+            {
+                printf("INFO : Please mention fsync policy correctly Eg:--fsync=file or --fsync=none, batch is for the daemon\n");
+                return e_failure;
+            }
+        }
+        else if (output == NULL)
+            output = argv[i];
+    }
     // checks if output filename with extension is provided or not
-    if (argv[3] != NULL && strstr(argv[3], ".") != NULL && ((strcmp(strstr(argv[3], "."), ".txt") == 0) || (strcmp(strstr(argv[3], "."), ".sh") == 0) || (strcmp(strstr(argv[3], "."), ".c") == 0)))
+    if (output != NULL && strstr(output, ".") != NULL && ((strcmp(strstr(output, "."), ".txt") == 0) || (strcmp(strstr(output, "."), ".sh") == 0) || (strcmp(strstr(output, "."), ".c") == 0)))
     {
         // stores it in decInfo
-        decInfo->output_fname = argv[3];
+        decInfo->output_fname = output;
     }
     else
     {
@@ -59,14 +86,43 @@ Status open_decode_files(DecodeInfo *decInfo)
     // if output file name is mentioned
     if (decInfo->output_fname != NULL)
     {
-        // output file
-        decInfo->fptr_output = fopen(decInfo->output_fname, "w");
+        // output file under a temporary name, renamed when complete
+        decInfo->fptr_output = durable_open(&decInfo->output_file, decInfo->output_fname);
+        if (decInfo->fptr_output == NULL)
+        {
+            perror("fopen ");
+            fprintf(stderr, "ERROR : Unable to open file %s\n", decInfo->output_fname);
+            fclose(decInfo->fptr_stego_image);
+            return e_failure;
+        }
     }
 
     // No failure return e_success
     return e_success;
 }
 
+/*
+ * Get per job buffers
+ * Inputs: decInfo
+ * Output: image_data and decoded_data point to chunk buffers and output_buf
+ * to a stdio buffer in the job arena of this thread, which is reset and reused
+ * by every later job
+ * Return Value: e_success or e_failure
+ */
+Status decode_alloc_buffers(DecodeInfo *decInfo)
+{
+    Arena *arena = job_arena();
+    if (arena == NULL)
+        return e_failure;
+    arena_reset(arena);
+    decInfo->image_data = arena_alloc(arena, MAX_IMAGE_BUF_SIZE * MAX_SECRET_CHUNK_SIZE);
+    decInfo->decoded_data = arena_alloc(arena, MAX_SECRET_CHUNK_SIZE);
+    decInfo->output_buf = arena_alloc(arena, BUFSIZ);
+    if (decInfo->image_data == NULL || decInfo->decoded_data == NULL || decInfo->output_buf == NULL)
+        return e_failure;
+    return e_success;
+}
+
 /* Decode magic string from stego image and check
  * Inputs: decInfo
  * Output: Magic string is decoded and checked
@@ -76,8 +132,11 @@ Status decode_magic_string(DecodeInfo *decInfo)
 {
     // variable i declared
     uint i;
-    // Seek 54 bytes from start to skip bmp header bytes
-    fseek(decInfo->fptr_stego_image, 54, SEEK_SET);
+    // Seek to pixel span to skip image header bytes, header is parsed by the carrier format
+    CarrierInfo carrier;
+    if (carrier_cache_get(decInfo->fptr_stego_image, &carrier) != e_success)
+        return e_failure;
+    fseeko(decInfo->fptr_stego_image, carrier.pixel_offset, SEEK_SET);
     // loop runs till size of magic string
     for (i = 0; i < 2; i++)
     {
@@ -101,6 +160,70 @@ Status decode_magic_string(DecodeInfo *decInfo)
         return e_failure;
 }
 
+/* Decode matrix embedded data
+ * Inputs: decInfo, destination and number of bytes
+ * Output: Only the blocks the bytes need are read, as many as fit the image
+ * buffer at a time. The syndrome of each block gives its p bits, MSB first.
+ * Bits past the last byte wait in matrix_acc for the next call
+ * Return Value: e_success or e_failure
+ */
+static Status decode_matrix_data(DecodeInfo *decInfo, char *data, uint size)
+{
+    uint bits = decInfo->matrix_bits;
+    uint block_size = matrix_block_size(bits);
+    uint max_blocks = MAX_IMAGE_BUF_SIZE * MAX_SECRET_CHUNK_SIZE / block_size;
+    char *end = data + size;
+    while (data < end)
+    {
+        // waiting bits first, a code longer than 8 bits may leave whole bytes
+        while (decInfo->matrix_acc_bits >= 8 && data < end)
+        {
+            decInfo->matrix_acc_bits -= 8;
+            *data++ = decInfo->matrix_acc >> decInfo->matrix_acc_bits;
+        }
+        if (data == end)
+            break;
+        uint64_t needed = (uint64_t)(end - data) * 8 - decInfo->matrix_acc_bits;
+        uint64_t blocks = (needed + bits - 1) / bits;
+        uint count = blocks < max_blocks ? blocks : max_blocks;
+        if (fread(decInfo->image_data, sizeof(char), count * block_size, decInfo->fptr_stego_image) != count * block_size)
+            return e_failure;
+        for (uint i = 0; i < count; i++)
+        {
+            decInfo->matrix_acc = decInfo->matrix_acc << bits | matrix_syndrome(decInfo->image_data + i * block_size, block_size);
+            decInfo->matrix_acc_bits += bits;
+            while (decInfo->matrix_acc_bits >= 8 && data < end)
+            {
+                decInfo->matrix_acc_bits -= 8;
+                *data++ = decInfo->matrix_acc >> decInfo->matrix_acc_bits;
+            }
+        }
+    }
+    return e_success;
+}
+
+/* Decode payload bytes after the header
+ * Inputs: decInfo, destination and number of bytes, at most MAX_SECRET_CHUNK_SIZE
+ * Output: Bytes are decoded one per 8 image bytes, or by syndromes of
+ * the blocks of a matrix embedded payload
+ * Return Value: e_success or e_failure
+ */
+Status decode_data_from_image(DecodeInfo *decInfo, char *data, uint size)
+{
+    if (decInfo->matrix_bits != 0)
+        return decode_matrix_data(decInfo, data, size);
+    // reads data from stego image to decInfo->image_data
+    if (fread(decInfo->image_data, sizeof(char), size * MAX_IMAGE_BUF_SIZE, decInfo->fptr_stego_image) != size * MAX_IMAGE_BUF_SIZE)
+        return e_failure;
+    // calls decode byte from lsb function for each byte
+    for (uint i = 0; i < size; i++)
+    {
+        if (decode_byte_from_lsb(data + i, decInfo->image_data + i * MAX_IMAGE_BUF_SIZE) != e_success)
+            return e_failure;
+    }
+    return e_success;
+}
+
 /* Decode data from LSB bits of stego image
  * Input: Image data and destination array decoded data
  * Output: Decodes and stores 1 byte data in decoded_data from 8 bytes image data
@@ -118,6 +241,48 @@ Status decode_byte_from_lsb(char *decoded_data, char *image_data)
     return e_success;
 }
 
+/* Decode header version from stego image
+ * Input: decInfo
+ * Output: Decodes the version byte and stores in decInfo
+ * Return: e_success or e_failure, if version is not supported
+ */
+Status decode_stego_version(DecodeInfo *decInfo)
+{
+    // reads stego image data to decInfo->image_data
+    fread(decInfo->image_data, sizeof(char), MAX_IMAGE_BUF_SIZE, decInfo->fptr_stego_image);
+    if (decode_byte_from_lsb(decInfo->decoded_data, decInfo->image_data) != e_success)
+        return e_failure;
+    decInfo->version = (unsigned char)decInfo->decoded_data[0];
+    decInfo->matrix_bits = 0;
+    if (decInfo->version == STEGO_VERSION_LEGACY)
+    {
+        // byte read belongs to the legacy 32 bit extn size, step back so it is decoded again
+        fseeko(decInfo->fptr_stego_image, -MAX_IMAGE_BUF_SIZE, SEEK_CUR);
+        return e_success;
+    }
+    if (decInfo->version == STEGO_VERSION)
+        return e_success;
+    if (decInfo->version == STEGO_VERSION_MATRIX)
+    {
+        // code parameter is the last byte embedded one bit per byte
+        fread(decInfo->image_data, sizeof(char), MAX_IMAGE_BUF_SIZE, decInfo->fptr_stego_image);
+        if (decode_byte_from_lsb(decInfo->decoded_data, decInfo->image_data) != e_success)
+            return e_failure;
+        uint bits = (unsigned char)decInfo->decoded_data[0];
+        if (bits < MATRIX_MIN_BITS || bits > MATRIX_MAX_BITS)
+        {
+            fprintf(stderr, "ERROR : Unsupported matrix code %u\n", bits);
+            return e_failure;
+        }
+        decInfo->matrix_bits = bits;
+        decInfo->matrix_acc = 0;
+        decInfo->matrix_acc_bits = 0;
+        return e_success;
+    }
+    fprintf(stderr, "ERROR : Unsupported stego header version %u\n", decInfo->version);
+    return e_failure;
+}
+
 /* Decode file extenstion size from stego image
  * Input: decInfo
  * Output: Decodes the file extenstion size
@@ -125,17 +290,30 @@ Status decode_byte_from_lsb(char *decoded_data, char *image_data)
  */
 Status decode_file_extn_size(DecodeInfo *decInfo)
 {
-    char str[32];
-    // reads stego image data to str
-    fread(str, sizeof(char), 32, decInfo->fptr_stego_image);
-    decInfo->size_image_data = 0;
-    // calls decode size from lsb function
-    if (decode_size_from_lsb(str, &decInfo->size_image_data) == e_success)
+    if (decInfo->version != STEGO_VERSION_LEGACY)
     {
-        return e_success;
+        // calls decode varint function
+        if (decode_varint(decInfo, &decInfo->size_image_data) != e_success)
+            return e_failure;
     }
     else
+    {
+        char str[32];
+        uint size = 0;
+        // reads stego image data to str
+        fread(str, sizeof(char), 32, decInfo->fptr_stego_image);
+        // calls decode size from lsb function
+        if (decode_size_from_lsb(str, &size) != e_success)
+            return e_failure;
+        decInfo->size_image_data = size;
+    }
+    // extension along with null character should fit in extn_output_file
+    if (decInfo->size_image_data >= MAX_FILE_SUFFIX)
+    {
+        fprintf(stderr, "ERROR : Decoded file extn size %llu is too long\n", (unsigned long long)decInfo->size_image_data);
         return e_failure;
+    }
+    return e_success;
 }
 
 /* Decodes size from LSB bits of stego image
@@ -154,6 +332,28 @@ Status decode_size_from_lsb(char *str, uint *size)
     return e_success;
 }
 
+/* Decodes varint size from stego image
+ * Input: decInfo and destination variable pointer
+ * Output: Decodes 7 bits per byte, low bits first, till a byte without MSB set
+ * Return: e_success or e_failure, if varint is longer than 64 bits
+ */
+Status decode_varint(DecodeInfo *decInfo, uint64_t *size)
+{
+    *size = 0;
+    for (uint i = 0; i < MAX_VARINT_SIZE; i++)
+    {
+        // decodes one byte of stego image data
+        if (decode_data_from_image(decInfo, decInfo->decoded_data, 1) != e_success)
+            return e_failure;
+        unsigned char byte = decInfo->decoded_data[0];
+        *size |= (uint64_t)(byte & 0x7F) << (7 * i);
+        // MSB not set marks the last byte
+        if ((byte & 0x80) == 0)
+            return e_success;
+    }
+    return e_failure;
+}
+
 /* Decode file extenstion from stego image
  * Input: decInfo and file extenstion size
  * Output: Decodes the file extenstion and stores in decInfo
@@ -166,9 +366,8 @@ Status decode_file_extn(uint size, DecodeInfo *decInfo)
     // loop runs till size
     for (i = 0; i < size; i++)
     {
-        // reads stego image data to decInfo->image_data
-        fread(decInfo->image_data, sizeof(char), MAX_IMAGE_BUF_SIZE, decInfo->fptr_stego_image);
-        if (decode_byte_from_lsb(decInfo->decoded_data, decInfo->image_data) == e_success)
+        // decodes one byte of stego image data
+        if (decode_data_from_image(decInfo, decInfo->decoded_data, 1) == e_success)
         {
             // stores decoded data
             decInfo->extn_output_file[i] = decInfo->decoded_data[0];
@@ -187,13 +386,19 @@ Status decode_file_extn(uint size, DecodeInfo *decInfo)
  */
 Status decode_file_size(DecodeInfo *decInfo)
 {
+    if (decInfo->version != STEGO_VERSION_LEGACY)
+    {
+        // calls decode varint
+        return decode_varint(decInfo, &decInfo->size_image_data);
+    }
     char str[32];
+    uint size = 0;
     // reads data from stego image to str
     fread(str, sizeof(char), 32, decInfo->fptr_stego_image);
-    decInfo->size_image_data = 0;
     // calls decode size from lsb
-    if (decode_size_from_lsb(str, &decInfo->size_image_data) == e_success)
+    if (decode_size_from_lsb(str, &size) == e_success)
     {
+        decInfo->size_image_data = size;
         return e_success;
     }
     else
@@ -204,27 +409,36 @@ Status decode_file_size(DecodeInfo *decInfo)
 
 /* Decode file data from stego image and write to output file
  * Input: decInfo
- * Output: Decodes the file data and write to output file
+ * Output: Decodes the file data in chunks and write to output file
  * Return: e_success or e_failure
  */
 Status decode_file_data(DecodeInfo *decInfo)
 {
-    // variable i declared
-    uint i;
-    // for loop runs till size of file
-    for (i = 0; i < decInfo->size_image_data; i++)
+    uint64_t remaining = decInfo->size_image_data;
+    uint64_t read_dropped = 0, written_dropped = 0;
+    // loop runs till size of file
+    while (remaining > 0)
     {
-        // reads data from stego image to decInfo->image_data
-        fread(decInfo->image_data, sizeof(char), MAX_IMAGE_BUF_SIZE, decInfo->fptr_stego_image);
-        // calls decode byte from lsb function
-        if (decode_byte_from_lsb(decInfo->decoded_data, decInfo->image_data) == e_success)
-        {
-            // writes decoded data to output file
-            fwrite(decInfo->decoded_data, sizeof(char), 1, decInfo->fptr_output);
-        }
-        else
-        {
+        uint chunk = remaining < MAX_SECRET_CHUNK_SIZE ? remaining : MAX_SECRET_CHUNK_SIZE;
+        // decodes a chunk of stego image data
+        if (decode_data_from_image(decInfo, decInfo->decoded_data, chunk) != e_success)
             return e_failure;
+        // writes decoded data to output file
+        if (fwrite(decInfo->decoded_data, sizeof(char), chunk, decInfo->fptr_output) != chunk)
+            return e_failure;
+        remaining -= chunk;
+        // bypassing the page cache, pages read and written are dropped every block
+        off_t read_offset = ftello(decInfo->fptr_stego_image);
+        if (decInfo->cache_mode != e_io_cached && (remaining == 0 || (uint64_t)read_offset - read_dropped >= IO_BLOCK_SIZE))
+        {
+            if (fflush(decInfo->fptr_output) != 0)
+                return e_failure;
+            off_t written_offset = ftello(decInfo->fptr_output);
+            io_drop_cache(fileno(decInfo->fptr_stego_image), read_dropped, read_offset - read_dropped, e_io_read);
+            if (written_offset > (off_t)written_dropped)
+                io_drop_cache(fileno(decInfo->fptr_output), written_dropped, written_offset - written_dropped, e_io_write);
+            read_dropped = read_offset;
+            written_dropped = written_offset;
         }
     }
 
@@ -239,6 +453,7 @@ Status decode_file_data(DecodeInfo *decInfo)
 Status do_decoding(DecodeInfo *decInfo)
 {
     // Calls each decoding functions one by one and checks if it is executed successfully
+    decInfo->fptr_output = NULL;
     if (open_decode_files(decInfo) == e_success)
     {
         printf("INFO : Files are opened successfully\n");
@@ -248,7 +463,38 @@ Status do_decoding(DecodeInfo *decInfo)
         printf("ERROR : Opening files failed\n");
         return e_failure;
     }
+    // partial output is removed, an older file of the same name is kept
+    if (do_decoding_with_files(decInfo) != e_success)
+    {
+        durable_abort(&decInfo->output_file, decInfo->fptr_output);
+        decInfo->fptr_output = NULL;
+        return e_failure;
+    }
+    Status status = durable_commit(&decInfo->output_file, decInfo->fptr_output, &decInfo->fsync_policy);
+    decInfo->fptr_output = NULL;
+    if (status == e_success)
+    {
+        printf("INFO : Output file %s is complete\n", decInfo->output_fname);
+    }
+    else
+    {
+        printf("ERROR : Committing output file %s failed\n", decInfo->output_fname);
+    }
+    return status;
+}
 
+/* Do decoding on opened files
+ * Inputs: decInfo with stego image file pointer, and output file pointer if output_fname is set
+ * Output: Calls each decoding functions one by one and checks if it is executed successfully
+ * Return Value: e_success or e_failure
+ */
+Status do_decoding_with_files(DecodeInfo *decInfo)
+{
+    if (decode_alloc_buffers(decInfo) != e_success)
+    {
+        printf("ERROR : Getting job buffers failed\n");
+        return e_failure;
+    }
     if (decode_magic_string(decInfo) == e_success)
     {
         printf("INFO : Decoding Magic string successful\n");
@@ -258,6 +504,15 @@ Status do_decoding(DecodeInfo *decInfo)
         printf("ERROR : Decoding Magic string failed\n");
         return e_failure;
     }
+    if (decode_stego_version(decInfo) == e_success)
+    {
+        printf("INFO : Decoding header version successful\n");
+    }
+    else
+    {
+        printf("ERROR : Decoding header version failed\n");
+        return e_failure;
+    }
     if (decode_file_extn_size(decInfo) == e_success)
     {
         printf("INFO : Decoding file extn size successful\n");
@@ -273,12 +528,17 @@ Status do_decoding(DecodeInfo *decInfo)
         if (decInfo->output_fname == NULL)
         {
             // Creates default output file with decoded file extension as output file name is not mentioned by user
-            char str[12] = "decoded";
-            strcat(str, decInfo->extn_output_file);
-            decInfo->output_fname = str;
+            snprintf(decInfo->default_output_fname, sizeof(decInfo->default_output_fname), "decoded%s", decInfo->extn_output_file);
+            decInfo->output_fname = decInfo->default_output_fname;
             printf("INFO : Output file name not mentioned / unsupported. Creating %s as default with decoded file extension\n", decInfo->output_fname);
-            // opening output file
-            decInfo->fptr_output = fopen(decInfo->output_fname, "w");
+            // opening output file under a temporary name, renamed when complete
+            decInfo->fptr_output = durable_open(&decInfo->output_file, decInfo->output_fname);
+            if (decInfo->fptr_output == NULL)
+            {
+                perror("fopen ");
+                printf("ERROR : Unable to open file %s\n", decInfo->output_fname);
+                return e_failure;
+            }
             printf("INFO : Opened %s\n", decInfo->output_fname);
         }
     }
@@ -296,7 +556,20 @@ Status do_decoding(DecodeInfo *decInfo)
         printf("ERROR : Decoding file size failed\n");
         return e_failure;
     }
-    if (decode_file_data(decInfo) == e_success)
+    // a limited output, like an inline reply, is checked before any data is written
+    if (decInfo->output_limit != 0 && decInfo->size_image_data > decInfo->output_limit)
+    {
+        printf("ERROR : Decoded file size %llu exceeds the output limit %llu\n", (unsigned long long)decInfo->size_image_data,
+               (unsigned long long)decInfo->output_limit);
+        return e_failure;
+    }
+    // output is not written yet, stdio would malloc its buffer on the first write
+    setvbuf(decInfo->fptr_output, decInfo->output_buf, _IOFBF, BUFSIZ);
+    // extraction below should make no heap call
+    uint64_t heap_calls = mem_heap_calls_thread();
+    Status data_status = decode_file_data(decInfo);
+    decInfo->heap_calls = mem_heap_calls_thread() - heap_calls;
+    if (data_status == e_success)
     {
         printf("INFO : Decoding file data successful\n");
     }
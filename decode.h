@@ -2,6 +2,8 @@
 #define DECODE_H
 
 #include "types.h" // Contains user defined types
+#include "io_engine.h"
+#include "durable.h"
 
 /*
  * Structure to store information required for
@@ -13,6 +15,7 @@
 #define MAX_SECRET_BUF_SIZE 1
 #define MAX_IMAGE_BUF_SIZE (MAX_SECRET_BUF_SIZE * 8)
 #define MAX_FILE_SUFFIX 5
+#define MAX_SECRET_CHUNK_SIZE 4096
 
 typedef struct _DecodeInfo
 {
@@ -20,15 +23,33 @@ typedef struct _DecodeInfo
 	/* Decoded output secret file info */
 	char *output_fname;
 	FILE *fptr_output;
+	DurableFile output_file;
+	FsyncPolicy fsync_policy;
+	/* Largest secret accepted, 0 for no limit */
+	uint64_t output_limit;
+	/* decoded + extn, when output file name is not mentioned */
+	char default_output_fname[16];
 	char extn_output_file[MAX_FILE_SUFFIX];
-	char decoded_data[MAX_SECRET_BUF_SIZE];
+	char *decoded_data;
+	/* stdio buffer of the output, so its first write makes no heap call */
+	char *output_buf;
 
 	/*stego image info */
 	char *stego_image_fname;
 	FILE *fptr_stego_image;
-	uint size_image_data;
-	char image_data[MAX_IMAGE_BUF_SIZE];
+	uint64_t size_image_data;
+	uint version;
+	char *image_data;
+	/* Code parameter of a matrix embedded payload, 0 if not, and decoded bits not yet returned */
+	uint matrix_bits;
+	uint32_t matrix_acc;
+	uint matrix_acc_bits;
 	char magic_string[3];
+
+	/* Page cache use of bulk jobs */
+	IoCacheMode cache_mode;
+	/* Heap calls made while extracting the payload, 0 in steady state */
+	uint64_t heap_calls;
 } DecodeInfo;
 
 /* Decoding function prototype */
@@ -39,12 +60,21 @@ Status read_and_validate_decode_args(char *argv[], DecodeInfo *decInfo);
 /* Perform the decoding*/
 Status do_decoding(DecodeInfo *decInfo);
 
+/* Perform the decoding on already opened files */
+Status do_decoding_with_files(DecodeInfo *decInfo);
+
 /* Get File pointers for i/p and o/p files */
 Status open_decode_files(DecodeInfo *decInfo);
 
+/* Get per job buffers from the job arena */
+Status decode_alloc_buffers(DecodeInfo *decInfo);
+
 /* Decode Magic String */
 Status decode_magic_string(DecodeInfo *decInfo);
 
+/* Decode header version */
+Status decode_stego_version(DecodeInfo *decInfo);
+
 /* Decode secret file extenstion size */
 Status decode_file_extn_size(DecodeInfo *decInfo);
 
@@ -57,10 +87,16 @@ Status decode_file_size(DecodeInfo *decInfo);
 /* Decode secret file data */
 Status decode_file_data(DecodeInfo *decInfo);
 
+/* Decode payload bytes after the header */
+Status decode_data_from_image(DecodeInfo *decInfo, char *data, uint size);
+
 /* Decode byte from LSBs of image data array */
 Status decode_byte_from_lsb(char *decode_data, char *image_data);
 
 /* Decode size from LSBs of image data array */
 Status decode_size_from_lsb(char *str, uint *size);
 
+/* Decode varint encoded size from stego image */
+Status decode_varint(DecodeInfo *decInfo, uint64_t *size);
+
 #endif
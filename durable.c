@@ -0,0 +1,260 @@
+// 64 bit file offsets so multi-GB carriers and payloads work
+#define _FILE_OFFSET_BITS 64
+// O_TMPFILE, linkat and syncfs
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "durable.h"
+#include "types.h"
+
+/* Outputs of a batch since the last syncfs, counted per process */
+static uint pending_outputs;
+static uint temp_counter;
+
+/* Function Definitions */
+
+/* Get fsync policy
+ * Inputs: Policy name and destination policy
+ * Return Value: e_success or e_failure, if the name is not known
+ */
+Status fsync_policy_parse(const char *name, FsyncPolicy *policy)
+{
+    policy->batch = FSYNC_DEFAULT_BATCH;
+    if (strcmp(name, "none") == 0)
+        policy->mode = e_fsync_none;
+    else if (strcmp(name, "file") == 0)
+        policy->mode = e_fsync_file;
+    else if (strcmp(name, "batch") == 0)
+        policy->mode = e_fsync_batch;
+    else if (strncmp(name, "batch:", 6) == 0 && atoi(name + 6) > 0)
+    {
+        policy->mode = e_fsync_batch;
+        policy->batch = atoi(name + 6);
+    }
+    else
+        return e_failure;
+    return e_success;
+}
+
+/* Default fsync policy
+ * Input: Destination policy
+ * Output: Policy named by STEGO_FSYNC, or file if it is not set or not valid
+ */
+void fsync_policy_default(FsyncPolicy *policy)
+{
+    const char *name = getenv(FSYNC_ENV);
+    if (name == NULL || fsync_policy_parse(name, policy) != e_success)
+    {
+        if (name != NULL)
+            printf("INFO : %s=%s is not a fsync policy, using file\n", FSYNC_ENV, name);
+        policy->mode = e_fsync_file;
+        policy->batch = FSYNC_DEFAULT_BATCH;
+    }
+}
+
+/* Default fsync policy of a single run
+ * Input: Destination policy
+ * Output: As fsync_policy_default, batch is turned into file as a run
+ * writing one output never completes a batch
+ */
+void fsync_policy_default_single(FsyncPolicy *policy)
+{
+    fsync_policy_default(policy);
+    if (policy->mode == e_fsync_batch)
+    {
+        printf("INFO : %s batch is used by the daemon, a single output uses file\n", FSYNC_ENV);
+        policy->mode = e_fsync_file;
+    }
+}
+
+/* Directory of a file name
+ * Inputs: File name and destination buffer
+ * Output: Part of the name before the last slash, or . if it has none
+ */
+static void durable_dirname(const char *fname, char *dir)
+{
+    const char *slash = strrchr(fname, '/');
+    if (slash == NULL)
+        strcpy(dir, ".");
+    else if (slash == fname)
+        strcpy(dir, "/");
+    else
+        snprintf(dir, DURABLE_PATH_MAX, "%.*s", (int)(slash - fname), fname);
+}
+
+/* Make a temporary name next to the real name
+ * Inputs: durable file and destination buffer
+ * Return Value: e_success or e_failure, if the name is too long
+ */
+static Status durable_temp_name(const DurableFile *file, char *tmp_fname)
+{
+    uint counter = __atomic_fetch_add(&temp_counter, 1, __ATOMIC_RELAXED);
+    int len = snprintf(tmp_fname, DURABLE_PATH_MAX, "%s.tmp%d.%u", file->fname, (int)getpid(), counter);
+    return len > 0 && len < DURABLE_PATH_MAX ? e_success : e_failure;
+}
+
+/* Open output
+ * Inputs: durable file and real name of the output
+ * Output: An unnamed O_TMPFILE file is created in the directory of the
+ * output. Where the filesystem or /proc does not support linking it later,
+ * a temporary name next to the real name is created instead
+ * Return Value: File pointer open for writing, or NULL
+ */
+FILE *durable_open(DurableFile *file, const char *fname)
+{
+    char dir[DURABLE_PATH_MAX];
+    file->fname = fname;
+    file->tmp_fname[0] = '\0';
+    if (strlen(fname) >= DURABLE_PATH_MAX - 32)
+        return NULL;
+    durable_dirname(fname, dir);
+    int fd = -1;
+#ifdef O_TMPFILE
+    // an O_TMPFILE file is linked through /proc/self/fd
+    if (access("/proc/self/fd", X_OK) == 0)
+        fd = open(dir, O_TMPFILE | O_WRONLY | O_CLOEXEC, 0666);
+#endif
+    if (fd < 0)
+    {
+        // an existing name is taken by a run that crashed, try the next one
+        for (uint i = 0; i < 16 && fd < 0; i++)
+        {
+            if (durable_temp_name(file, file->tmp_fname) != e_success)
+                return NULL;
+            fd = open(file->tmp_fname, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+            if (fd < 0 && errno != EEXIST)
+                break;
+        }
+        if (fd < 0)
+        {
+            file->tmp_fname[0] = '\0';
+            return NULL;
+        }
+    }
+    FILE *fptr = fdopen(fd, "w");
+    if (fptr == NULL)
+    {
+        close(fd);
+        if (file->tmp_fname[0] != '\0')
+            unlink(file->tmp_fname);
+        file->tmp_fname[0] = '\0';
+    }
+    return fptr;
+}
+
+/* Commit output
+ * Inputs: durable file, its file pointer and fsync policy
+ * Output: Buffered data is written and, for policy file, synced before the
+ * file is linked or renamed to its real name, replacing an older file at
+ * once. It is closed. Directory is synced for policy file, batch syncs the
+ * filesystem once every N outputs of the process, data and names together
+ * Return Value: e_success or e_failure, the temporary file is removed on failure
+ */
+Status durable_commit(DurableFile *file, FILE *fptr, const FsyncPolicy *policy)
+{
+    int fd = fileno(fptr);
+    if (fflush(fptr) != 0 || ferror(fptr) || (policy->mode == e_fsync_file && fsync(fd) != 0))
+    {
+        perror("fsync ");
+        durable_abort(file, fptr);
+        return e_failure;
+    }
+
+    Status status = e_success;
+    if (file->tmp_fname[0] == '\0')
+    {
+        char proc_fname[64];
+        snprintf(proc_fname, sizeof(proc_fname), "/proc/self/fd/%d", fd);
+        // real name is free, else linked under a temporary name and renamed over it
+        if (linkat(AT_FDCWD, proc_fname, AT_FDCWD, file->fname, AT_SYMLINK_FOLLOW) != 0)
+        {
+            if (errno != EEXIST || durable_temp_name(file, file->tmp_fname) != e_success ||
+                linkat(AT_FDCWD, proc_fname, AT_FDCWD, file->tmp_fname, AT_SYMLINK_FOLLOW) != 0)
+            {
+                file->tmp_fname[0] = '\0';
+                status = e_failure;
+            }
+        }
+    }
+    if (status == e_success && file->tmp_fname[0] != '\0' && rename(file->tmp_fname, file->fname) != 0)
+        status = e_failure;
+    if (status != e_success)
+    {
+        perror("rename ");
+        durable_abort(file, fptr);
+        return e_failure;
+    }
+    file->tmp_fname[0] = '\0';
+
+    if (policy->mode == e_fsync_file)
+        status = durable_sync_dir(file->fname);
+    else if (policy->mode == e_fsync_batch)
+        status = durable_sync_fd(fd, policy);
+    if (fclose(fptr) != 0)
+        status = e_failure;
+    return status;
+}
+
+/* Sync directory of a file
+ * Input: File name
+ * Output: Directory holding the file is synced, so a name given to the file
+ * by link or rename survives a crash
+ * Return Value: e_success or e_failure
+ */
+Status durable_sync_dir(const char *fname)
+{
+    char dir[DURABLE_PATH_MAX];
+    durable_dirname(fname, dir);
+    int dir_fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    Status status = dir_fd >= 0 && fsync(dir_fd) == 0 ? e_success : e_failure;
+    if (dir_fd >= 0)
+        close(dir_fd);
+    return status;
+}
+
+/* Abort output
+ * Inputs: durable file and its file pointer, may be NULL
+ * Output: File is closed and its temporary name removed, an O_TMPFILE
+ * file vanishes on close
+ */
+void durable_abort(DurableFile *file, FILE *fptr)
+{
+    if (fptr != NULL)
+        fclose(fptr);
+    if (file->tmp_fname[0] != '\0')
+        unlink(file->tmp_fname);
+    file->tmp_fname[0] = '\0';
+}
+
+/* Sync output by descriptor
+ * Inputs: Descriptor of a finished output and fsync policy
+ * Output: For policy file it is synced, for batch every Nth output of the
+ * process, committed or synced by descriptor, runs syncfs on its filesystem
+ * Return Value: e_success or e_failure
+ */
+Status durable_sync_fd(int fd, const FsyncPolicy *policy)
+{
+    if (policy->mode == e_fsync_file)
+        return fsync(fd) == 0 ? e_success : e_failure;
+    if (policy->mode == e_fsync_batch && __atomic_add_fetch(&pending_outputs, 1, __ATOMIC_RELAXED) >= policy->batch)
+    {
+        __atomic_store_n(&pending_outputs, 0, __ATOMIC_RELAXED);
+        return syncfs(fd) == 0 ? e_success : e_failure;
+    }
+    return e_success;
+}
+
+/* Sync unfinished batch
+ * Output: Outputs counted by durable_sync_fd since the last syncfs are
+ * synced, their filesystems are not known so every filesystem is
+ */
+void durable_sync_pending(void)
+{
+    if (__atomic_exchange_n(&pending_outputs, 0, __ATOMIC_RELAXED) > 0)
+        sync();
+}
@@ -0,0 +1,85 @@
+#ifndef DURABLE_H
+#define DURABLE_H
+
+#include <stdio.h>
+#include "types.h" // Contains user defined types
+
+/*
+ * Crash safe output files. An output is written to an
+ * unnamed O_TMPFILE file in its directory, or to a
+ * temporary name where that is not supported, and only
+ * linked or renamed to its real name once complete.
+ * Durability follows the fsync policy:
+ *
+ * file      data is synced before the rename and the
+ *           directory after it, for every output
+ * batch:N   nothing is synced per output, every Nth
+ *           output of the process runs one syncfs, making
+ *           data and names of it and the outputs before it
+ *           durable. Only the daemon batches, a single run
+ *           uses file
+ * none      nothing is synced, left to kernel writeback
+ *
+ * With file the real name never holds a partial file. A
+ * machine crash may lose or tear the latest outputs of a
+ * batch, up to N - 1, with none any output. A crash of the
+ * process never leaves a partial file under the real name
+ */
+
+#define FSYNC_FLAG "--fsync="
+#define FSYNC_ENV "STEGO_FSYNC"
+#define FSYNC_DEFAULT_BATCH 32
+#define DURABLE_PATH_MAX 4096
+
+typedef enum
+{
+    e_fsync_none,
+    e_fsync_file,
+    e_fsync_batch
+} FsyncMode;
+
+typedef struct _FsyncPolicy
+{
+    FsyncMode mode;
+    /* Outputs per syncfs for batch mode */
+    uint batch;
+} FsyncPolicy;
+
+/* Output file being written */
+typedef struct _DurableFile
+{
+    const char *fname;
+    /* Temporary name, empty for an O_TMPFILE file */
+    char tmp_fname[DURABLE_PATH_MAX];
+} DurableFile;
+
+/* Durable output function prototype */
+
+/* Get policy from file, none, batch or batch:N */
+Status fsync_policy_parse(const char *name, FsyncPolicy *policy);
+
+/* Policy from STEGO_FSYNC, file if not set */
+void fsync_policy_default(FsyncPolicy *policy);
+
+/* Policy from STEGO_FSYNC for a run writing one output, batch becomes file */
+void fsync_policy_default_single(FsyncPolicy *policy);
+
+/* Open output for writing under a temporary name */
+FILE *durable_open(DurableFile *file, const char *fname);
+
+/* Sync by policy, give output its real name and close it */
+Status durable_commit(DurableFile *file, FILE *fptr, const FsyncPolicy *policy);
+
+/* Close output and remove it, real name is left untouched */
+void durable_abort(DurableFile *file, FILE *fptr);
+
+/* Sync directory holding a file, so its name is durable */
+Status durable_sync_dir(const char *fname);
+
+/* Sync an output known only by its descriptor */
+Status durable_sync_fd(int fd, const FsyncPolicy *policy);
+
+/* Sync outputs of an unfinished batch of durable_sync_fd */
+void durable_sync_pending(void);
+
+#endif
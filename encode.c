@@ -1,24 +1,103 @@
+// 64 bit file offsets so multi-GB carriers and payloads work
+#define _FILE_OFFSET_BITS 64
+// copy_file_range
+#define _GNU_SOURCE
+
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <linux/fs.h>
+#endif
 #include "encode.h"
+#include "steg_reader.h"
+#include "checkpoint.h"
+#include "mem_pool.h"
+#include "matrix.h"
 #include "types.h"
 #include "common.h"
 
 /* Function Definitions */
 
+/* Read size of synthesized carrier
+ * Inputs: Carrier argument and encInfo
+ * Output: --synthesize alone, or --synthesize=WxH with an optional x24 or
+ * x32 bit depth, is stored in encInfo. A 0 width or height is sized from the
+ * secret
+ * Return Value: e_success or e_failure, if the argument is not valid
+ */
+static Status read_synth_size(const char *arg, EncodeInfo *encInfo)
+{
+    encInfo->synth_width = encInfo->synth_height = 0;
+    encInfo->synth_bits_per_pixel = 24;
+    arg += strlen(CARRIER_SYNTH_FLAG);
+    if (*arg == '\0')
+        return e_success;
+    unsigned long long width, height;
+    int len = 0;
+    if (*arg != '=' || sscanf(arg + 1, "%llux%llu%n", &width, &height, &len) != 2)
+        return e_failure;
+    arg += 1 + len;
+    if (*arg != '\0' && (sscanf(arg, "x%u%n", &encInfo->synth_bits_per_pixel, &len) != 1 || arg[len] != '\0'))
+        return e_failure;
+    encInfo->synth_width = width;
+    encInfo->synth_height = height;
+    return encInfo->synth_bits_per_pixel == 24 || encInfo->synth_bits_per_pixel == 32 ? e_success : e_failure;
+}
+
+/* Read matrix embedding code
+ * Inputs: Matrix argument and encInfo
+ * Output: --matrix alone leaves the code to check_capacity, --matrix=p
+ * stores code parameter p
+ * Return Value: e_success or e_failure, if p is not a supported code
+ */
+static Status read_matrix_bits(const char *arg, EncodeInfo *encInfo)
+{
+    encInfo->matrix = 1;
+    encInfo->matrix_bits = 0;
+    arg += strlen(MATRIX_FLAG);
+    if (*arg == '\0')
+        return e_success;
+    int len = 0;
+    if (*arg != '=' || sscanf(arg + 1, "%u%n", &encInfo->matrix_bits, &len) != 1 || arg[1 + len] != '\0')
+        return e_failure;
+    return encInfo->matrix_bits >= MATRIX_MIN_BITS && encInfo->matrix_bits <= MATRIX_MAX_BITS ? e_success : e_failure;
+}
+
 /* Read and validate encode arguments
  * Input: Command line arguments and encInfo
- * Output: File names are stored in encInfo
+ * Output: File names are stored in encInfo. For a stego image named - the
+ * stego image file pointer gets stdout and stdout is pointed at stderr
  * Return: e_success or e_failure
  */
 Status read_and_validate_encode_args(char *argv[], EncodeInfo *encInfo)
 {
-    // Checks if 2nd argument passed is a .bmp file
-    if (strstr(argv[2], ".") != NULL && (strcmp(strstr(argv[2], "."), ".bmp") == 0))
+    // Checks if 2nd argument passed is a carrier image file, .bmp, .ppm, .pgm or .tga
+    const CarrierFormat *format = carrier_format_by_name(argv[2]);
+    encInfo->synthesize = 0;
+    if (format != NULL)
     {
         // stores it in encInfo
         encInfo->src_image_fname = argv[2];
     }
+    // or synthesizes a BMP carrier
+    else if (strncmp(argv[2], CARRIER_SYNTH_FLAG, strlen(CARRIER_SYNTH_FLAG)) == 0)
+    {
+        if (read_synth_size(argv[2], encInfo) != e_success)
+        {
+            printf("INFO : Please mention synthesized carrier size correctly Eg:--synthesize, --synthesize=640x480 or --synthesize=640x0x32\n");
+            return e_failure;
+        }
+        encInfo->synthesize = 1;
+        encInfo->src_image_fname = argv[2];
+        encInfo->carrier.format = e_carrier_bmp;
+        format = carrier_format(&encInfo->carrier);
+    }
     else
     {
         printf("INFO : Please mention image file correctly Eg:beautiful.bmp\n");
@@ -38,17 +117,80 @@ Status read_and_validate_encode_args(char *argv[], EncodeInfo *encInfo)
         // returns failure
         return e_failure;
     }
-    // checks if output filename with .bmp extension is provided or not
-    if (argv[4] != NULL && strstr(argv[4], ".") != NULL && ((strcmp(strstr(argv[4], "."), ".bmp") == 0)))
+    // optional output filename and --resume, --direct, --fsync= and --matrix flags, in any order
+    char *output = NULL;
+    encInfo->resume = 0;
+    encInfo->matrix = 0;
+    encInfo->matrix_bits = 0;
+    encInfo->cache_mode = e_io_cached;
+    fsync_policy_default_single(&encInfo->fsync_policy);
+    for (uint i = 4; argv[i] != NULL; i++)
+    {
+        if (strcmp(argv[i], ENCODE_RESUME_FLAG) == 0)
+            encInfo->resume = 1;
+        else if (strcmp(argv[i], IO_DIRECT_FLAG) == 0)
+            encInfo->cache_mode = e_io_direct;
+        else if (strncmp(argv[i], FSYNC_FLAG, strlen(FSYNC_FLAG)) == 0)
+        {
+            // batches span the requests of the daemon, a run writes one output
+            if (fsync_policy_parse(argv[i] + strlen(FSYNC_FLAG), &encInfo->fsync_policy) != e_success ||
+                encInfo->fsync_policy.mode == e_fsync_batch)
+            {
+                printf("INFO : Please mention fsync policy correctly Eg:--fsync=file or --fsync=none, batch is for the daemon\n");
+                return e_failure;
+            }
+        }
+        else if (strncmp(argv[i], MATRIX_FLAG, strlen(MATRIX_FLAG)) == 0)
+        {
+            if (read_matrix_bits(argv[i], encInfo) != e_success)
+            {
+                printf("INFO : Please mention matrix code correctly Eg:--matrix or --matrix=8, from %d to %d\n", MATRIX_MIN_BITS, MATRIX_MAX_BITS);
+                return e_failure;
+            }
+        }
+        else if (output == NULL)
+            output = argv[i];
+    }
+    // checks if output filename with the extension of the carrier format is provided or not
+    if (output != NULL && carrier_format_by_name(output) == format)
     {
         // stores it in encInfo
-        encInfo->stego_image_fname = argv[4];
+        encInfo->stego_image_fname = output;
+    }
+    // stego image is streamed to stdout, so messages are moved to stderr
+    else if (output != NULL && strcmp(output, STEGO_STDOUT_FNAME) == 0)
+    {
+        encInfo->stego_image_fname = STEGO_STDOUT_FNAME;
+        int stream_fd = dup(STDOUT_FILENO);
+        if (stream_fd < 0 || (encInfo->fptr_stego_image = fdopen(stream_fd, "w")) == NULL)
+        {
+            perror("fdopen ");
+            return e_failure;
+        }
+        dup2(STDERR_FILENO, STDOUT_FILENO);
     }
     else
     {
         // stores default name in  encInfo
-        printf("INFO : Output filename not mentioned / mentioned without .bmp extension. Creating stego.bmp as default\n");
-        encInfo->stego_image_fname = "stego.bmp";
+        printf("INFO : Output filename not mentioned / mentioned without %s extension. Creating %s as default\n", format->extn,
+               format->default_stego_fname);
+        encInfo->stego_image_fname = (char *)format->default_stego_fname;
+    }
+    if (encInfo->resume && strcmp(encInfo->stego_image_fname, STEGO_STDOUT_FNAME) == 0)
+    {
+        printf("INFO : Streamed stego image can not be resumed\n");
+        return e_failure;
+    }
+    if (encInfo->resume && encInfo->synthesize)
+    {
+        printf("INFO : Encoding to a synthesized carrier can not be resumed\n");
+        return e_failure;
+    }
+    // stego reader embeds one bit per byte
+    if (encInfo->matrix && (encInfo->resume || encInfo->synthesize || strcmp(encInfo->stego_image_fname, STEGO_STDOUT_FNAME) == 0))
+    {
+        printf("INFO : Matrix embedding needs a carrier image and a stego image file, without --resume\n");
+        return e_failure;
     }
     return e_success;
 }
@@ -62,10 +204,12 @@ Status read_and_validate_encode_args(char *argv[], EncodeInfo *encInfo)
  */
 Status open_files(EncodeInfo *encInfo)
 {
-    // Open Src Image file
-    encInfo->fptr_src_image = fopen(encInfo->src_image_fname, "r");
+    // Open Src Image file, none for a synthesized carrier
+    encInfo->fptr_src_image = NULL;
+    if (!encInfo->synthesize)
+        encInfo->fptr_src_image = fopen(encInfo->src_image_fname, "r");
     // Do Error handling
-    if (encInfo->fptr_src_image == NULL)
+    if (!encInfo->synthesize && encInfo->fptr_src_image == NULL)
     {
         perror("fopen ");
         fprintf(stderr, "ERROR : Unable to open file %s\n", encInfo->src_image_fname);
@@ -84,8 +228,12 @@ Status open_files(EncodeInfo *encInfo)
         return e_failure;
     }
 
-    // Open Stego Image file
-    encInfo->fptr_stego_image = fopen(encInfo->stego_image_fname, "w");
+    // Stego image streamed to stdout is opened by the caller
+    if (strcmp(encInfo->stego_image_fname, STEGO_STDOUT_FNAME) == 0)
+        return encInfo->fptr_stego_image != NULL ? e_success : e_failure;
+
+    // Open Stego Image file under a temporary name, renamed when complete
+    encInfo->fptr_stego_image = durable_open(&encInfo->stego_file, encInfo->stego_image_fname);
     // Do Error handling
     if (encInfo->fptr_stego_image == NULL)
     {
@@ -99,20 +247,53 @@ Status open_files(EncodeInfo *encInfo)
     return e_success;
 }
 
+/*
+ * Get per job buffers
+ * Inputs: encInfo
+ * Output: image_data and secret_data point to chunk buffers in the job arena
+ * of this thread, which is reset and reused by every later job
+ * Return Value: e_success or e_failure
+ */
+Status encode_alloc_buffers(EncodeInfo *encInfo)
+{
+    Arena *arena = job_arena();
+    if (arena == NULL)
+        return e_failure;
+    arena_reset(arena);
+    encInfo->image_data = arena_alloc(arena, MAX_IMAGE_BUF_SIZE * MAX_SECRET_CHUNK_SIZE);
+    encInfo->secret_data = arena_alloc(arena, MAX_SECRET_CHUNK_SIZE);
+    if (encInfo->image_data == NULL || encInfo->secret_data == NULL)
+        return e_failure;
+    return e_success;
+}
+
 /*
  * Check capacity of src image
  * Inputs: encInfo
- * Output: Checks if capacity of source image is greater than data to be encoded
+ * Output: Checks if capacity of source image is greater than data to be
+ * encoded. With matrix embedding and no code given, the largest code that
+ * fits is picked
  * Return Value: e_success or e_failure
  */
 Status check_capacity(EncodeInfo *encInfo)
 {
-    // Gets image and secret file sizes
-    encInfo->image_capacity = get_image_size_for_bmp(encInfo->fptr_src_image);
+    // Gets image header, from the carrier cache when possible, and secret file size
+    if (carrier_cache_get(encInfo->fptr_src_image, &encInfo->carrier) != e_success)
+        return e_failure;
+    encInfo->image_capacity = encInfo->carrier.capacity;
     encInfo->size_secret_file = get_file_size(encInfo->fptr_secret);
     strcpy(encInfo->extn_secret_file, strstr(encInfo->secret_fname, "."));
+    uint64_t payload_size = get_payload_size(encInfo->extn_secret_file, encInfo->size_secret_file);
+    if (encInfo->matrix)
+    {
+        if (encInfo->matrix_bits == 0)
+            encInfo->matrix_bits = matrix_best_bits(encInfo->image_capacity, payload_size);
+        if (encInfo->matrix_bits != 0 && encInfo->image_capacity > matrix_carrier_bytes(encInfo->matrix_bits, payload_size))
+            return e_success;
+        return e_failure;
+    }
     // Checks if capacity of source image is greater than data to be encoded
-    if (encInfo->image_capacity > (strlen(MAGIC_STRING) * 8 + 32 + strlen(encInfo->extn_secret_file) * 8 + 32 + (encInfo->size_secret_file * 8)))
+    if (encInfo->image_capacity > payload_size * 8)
     {
         return e_success;
     }
@@ -122,26 +303,17 @@ Status check_capacity(EncodeInfo *encInfo)
     }
 }
 
-/* Get image size
- * Input: Image file ptr
- * Output: width * height * bytes per pixel (3 in our case)
- * Description: In BMP Image, width is stored in offset 18,
- * and height after that. size is 4 bytes
+/* Get payload size
+ * Inputs: Secret file extension and size
+ * Output: Bytes embedded for the secret, magic string, version, extn size,
+ * extn and file size followed by the data. Varints are only as long as the
+ * value needs
+ * Return: Payload size in bytes
  */
-uint get_image_size_for_bmp(FILE *fptr_image)
+uint64_t get_payload_size(const char *extn, uint64_t secret_size)
 {
-    uint width, height;
-    // Seek to 18th byte
-    fseek(fptr_image, 18, SEEK_SET);
-
-    // Read the width (an int)
-    fread(&width, sizeof(int), 1, fptr_image);
-
-    // Read the height (an int)
-    fread(&height, sizeof(int), 1, fptr_image);
-
-    // Return image capacity
-    return width * height * 3;
+    char varint[MAX_VARINT_SIZE];
+    return strlen(MAGIC_STRING) + 1 + encode_varint(strlen(extn), varint) + strlen(extn) + encode_varint(secret_size, varint) + secret_size;
 }
 
 /* Get file size
@@ -149,27 +321,10 @@ uint get_image_size_for_bmp(FILE *fptr_image)
  * Output: File size
  * Return: File size in bytes is returned
  */
-uint get_file_size(FILE *fptr)
+uint64_t get_file_size(FILE *fptr)
 {
-    fseek(fptr, 0, SEEK_END);
-    return ftell(fptr);
-}
-
-/* Copy bmp header of src image to stego image
- * Inputs: Source and Stego image file pointers
- * Output: Bmp header of src image is copied to  stego image
- * Return Value: e_success or e_failure
- */
-Status copy_bmp_header(FILE *fptr_src_image, FILE *fptr_dest_image)
-{
-    // string with 54 bytes
-    char str[54];
-    // rewinds src image pointer to start
-    rewind(fptr_src_image);
-    // copies bmp header to str and writes to stego image
-    fread(str, sizeof(char), 54, fptr_src_image);
-    fwrite(str, sizeof(char), 54, fptr_dest_image);
-    return e_success;
+    fseeko(fptr, 0, SEEK_END);
+    return ftello(fptr);
 }
 
 /* Encode magic string to stego image
@@ -180,7 +335,7 @@ Status copy_bmp_header(FILE *fptr_src_image, FILE *fptr_dest_image)
 Status encode_magic_string(const char *magic_string, EncodeInfo *encInfo)
 {
     // calls encode data to image function
-    if (encode_data_to_image(magic_string, strlen(magic_string), encInfo->fptr_src_image, encInfo->fptr_stego_image, encInfo) == e_success)
+    if (encode_data_to_image(magic_string, strlen(magic_string), encInfo) == e_success)
     {
         return e_success;
     }
@@ -190,28 +345,141 @@ Status encode_magic_string(const char *magic_string, EncodeInfo *encInfo)
     }
 }
 
+/* Encode header version to stego image
+ * Inputs: Version and encInfo
+ * Output: Version byte is encoded to stego image
+ * Return Value: e_success or e_failure
+ */
+Status encode_stego_version(uint version, EncodeInfo *encInfo)
+{
+    char data = version;
+    // calls encode data to image function
+    return encode_data_to_image(&data, 1, encInfo);
+}
+
+/* Store code parameter of matrix embedding
+ * Inputs: Code parameter and encInfo
+ * Output: Code parameter byte is encoded one bit per byte like the rest of
+ * the header, data after it is matrix embedded
+ * Return Value: e_success or e_failure
+ */
+Status encode_matrix_bits(uint bits, EncodeInfo *encInfo)
+{
+    char data = bits;
+    if (encode_data_to_image(&data, 1, encInfo) != e_success)
+        return e_failure;
+    encInfo->matrix_active = 1;
+    encInfo->matrix_acc = 0;
+    encInfo->matrix_acc_bits = 0;
+    encInfo->matrix_changed = 0;
+    return e_success;
+}
+
+/* Embed blocks of matrix embedding
+ * Inputs: Number of blocks, data with at least the bits they need, and encInfo
+ * Output: Blocks are read from src image as many as fit the image buffer at
+ * a time, each gets the next p bits of the data, MSB first, and is written
+ * to stego image. Bits left of a data byte wait in matrix_acc
+ * Return Value: Data after the bits embedded, NULL on failure
+ */
+static const char *encode_matrix_blocks(uint64_t blocks, const char *data, EncodeInfo *encInfo)
+{
+    char *image_buff = encInfo->image_data;
+    uint bits = encInfo->matrix_bits;
+    uint block_size = matrix_block_size(bits);
+    uint max_blocks = MAX_IMAGE_BUF_SIZE * MAX_SECRET_CHUNK_SIZE / block_size;
+    while (blocks > 0)
+    {
+        uint count = blocks < max_blocks ? blocks : max_blocks;
+        if (io_engine_read(&encInfo->src_io, image_buff, count * block_size) != count * block_size)
+            return NULL;
+        for (uint i = 0; i < count; i++)
+        {
+            while (encInfo->matrix_acc_bits < bits)
+            {
+                encInfo->matrix_acc = encInfo->matrix_acc << 8 | (unsigned char)*data++;
+                encInfo->matrix_acc_bits += 8;
+            }
+            encInfo->matrix_acc_bits -= bits;
+            uint message = (encInfo->matrix_acc >> encInfo->matrix_acc_bits) & block_size;
+            encInfo->matrix_changed += matrix_embed(image_buff + i * block_size, block_size, message);
+        }
+        if (io_engine_write(&encInfo->stego_io, image_buff, count * block_size) != e_success)
+            return NULL;
+        blocks -= count;
+    }
+    return data;
+}
+
+/* Matrix embed data
+ * Inputs: Data to encode and encInfo
+ * Output: Every whole p bits of the waiting bits and the data are embedded,
+ * the bits left over wait for the next data or encode_matrix_flush
+ * Return Value: e_success or e_failure
+ */
+static Status encode_matrix_data(const char *data, uint size, EncodeInfo *encInfo)
+{
+    const char *end = data + size;
+    uint64_t blocks = (encInfo->matrix_acc_bits + (uint64_t)size * 8) / encInfo->matrix_bits;
+    data = encode_matrix_blocks(blocks, data, encInfo);
+    if (data == NULL)
+        return e_failure;
+    while (data < end)
+    {
+        encInfo->matrix_acc = encInfo->matrix_acc << 8 | (unsigned char)*data++;
+        encInfo->matrix_acc_bits += 8;
+    }
+    return e_success;
+}
+
+/* Embed payload bits still waiting for a block
+ * Inputs: encInfo
+ * Output: Last bits are padded with 0 to p bits and embedded in one block
+ * Return Value: e_success or e_failure
+ */
+Status encode_matrix_flush(EncodeInfo *encInfo)
+{
+    if (encInfo->matrix_acc_bits == 0)
+        return e_success;
+    char pad = 0;
+    // p zero bits after the waiting bits fill the block, no data byte is read
+    encInfo->matrix_acc <<= encInfo->matrix_bits;
+    encInfo->matrix_acc_bits += encInfo->matrix_bits;
+    if (encode_matrix_blocks(1, &pad, encInfo) == NULL)
+        return e_failure;
+    encInfo->matrix_acc_bits = 0;
+    return e_success;
+}
+
 /* Encode function, which does the real encoding
- * Inputs: Data to encode,encInfo, source and stego image file pointers
- * Output: Data is encoded to stego image
+ * Inputs: Data to encode and encInfo
+ * Output: Data is encoded to stego image, image data is read and written
+ * through the I/O engines in chunks. After the header of a matrix embedded
+ * payload, data is matrix embedded instead
  * Return Value: e_success or e_failure
  */
-Status encode_data_to_image(const char *data, int size, FILE *fptr_src_image, FILE *fptr_stego_image, EncodeInfo *encInfo)
+Status encode_data_to_image(const char *data, uint size, EncodeInfo *encInfo)
 {
-    // for loop that runs till the passed size
-    for (int i = 0; i < size; i++)
+    if (encInfo->matrix_active)
+        return encode_matrix_data(data, size, encInfo);
+    char *image_buff = encInfo->image_data;
+    while (size > 0)
     {
-        // read 8 byte image data from src image
-        fread(encInfo->image_data, sizeof(char), 8, fptr_src_image);
+        uint chunk = size < MAX_SECRET_CHUNK_SIZE ? size : MAX_SECRET_CHUNK_SIZE;
+        // read 8 byte image data per data byte from src image
+        if (io_engine_read(&encInfo->src_io, image_buff, chunk * MAX_IMAGE_BUF_SIZE) != chunk * MAX_IMAGE_BUF_SIZE)
+            return e_failure;
         // passes it to encode_byte_to_lsb and checks if it returns e_success
-        if (encode_byte_to_lsb(data[i], encInfo->image_data) == e_success)
+        for (uint i = 0; i < chunk; i++)
         {
-            // writes to stego image
-            fwrite(encInfo->image_data, sizeof(char), 8, fptr_stego_image);
+            if (encode_byte_to_lsb(data[i], image_buff + i * MAX_IMAGE_BUF_SIZE) != e_success)
+                return e_failure;
         }
-        // if encode_byte_to_lsb doesnt return e_success
-        else
-            // returns e_failure
+        // writes to stego image
+        if (io_engine_write(&encInfo->stego_io, image_buff, chunk * MAX_IMAGE_BUF_SIZE) != e_success)
             return e_failure;
+        data += chunk;
+        size -= chunk;
     }
     return e_success;
 }
@@ -235,41 +503,34 @@ Status encode_byte_to_lsb(char data, char *image_buffer)
 }
 
 /* Encode secret file extension size to stego image
- * Inputs: Size to encode, src and stego image file pointers
+ * Inputs: Size to encode and encInfo
  * Output: Data is encoded to stego image
  * Return Value: e_success or e_failure
  */
-Status encode_secret_file_extn_size(int size, FILE *fptr_src_image, FILE *fptr_stego_image)
+Status encode_secret_file_extn_size(uint size, EncodeInfo *encInfo)
 {
-    char str[32];
-    fread(str, sizeof(char), 32, fptr_src_image);
-    // passes str and size to encode_size_to_lsb and checks if it returns e_success
-    if (encode_size_to_lsb(str, size) == e_success)
-    {
-        // writes to stego image
-        fwrite(str, sizeof(char), 32, fptr_stego_image);
-        return e_success;
-    }
-    else
-        return e_failure;
+    char str[MAX_VARINT_SIZE];
+    // converts size to varint and encodes it
+    uint len = encode_varint(size, str);
+    return encode_data_to_image(str, len, encInfo);
 }
 
-/* Encode size into LSB of image data array
- * Inputs: 4 byte data to encode and 32 byte image data
- * Output: Data is encoded to image buffer
- * Return Value: e_success or e_failure
+/* Encode size as varint
+ * Inputs: Size to encode and destination buffer of MAX_VARINT_SIZE bytes
+ * Output: 7 bits of size per byte, low bits first, MSB set on all but the last byte
+ * Return Value: Number of bytes used
  */
-Status encode_size_to_lsb(char *buffer, int size)
+uint encode_varint(uint64_t size, char *buffer)
 {
-    // mask variable declared and initialised
-    uint mask = 1 << 31;
-    // 4 byte data encoded to 32 byte image data
-    for (int i = 0; i < 32; i++)
+    uint len = 0;
+    // stores 7 bits at a time till remaining bits fit in one byte
+    while (size >= 0x80)
     {
-        buffer[i] = (buffer[i] & 0xFE) | ((size & mask) >> (31 - i));
-        mask >>= 1;
+        buffer[len++] = (size & 0x7F) | 0x80;
+        size >>= 7;
     }
-    return e_success;
+    buffer[len++] = size;
+    return len;
 }
 
 /* Encode secret file extension to stego image
@@ -280,7 +541,7 @@ Status encode_size_to_lsb(char *buffer, int size)
 Status encode_secret_file_extn(const char *file_extn, EncodeInfo *encInfo)
 {
     // calls encode data to image function
-    if (encode_data_to_image(file_extn, strlen(file_extn), encInfo->fptr_src_image, encInfo->fptr_stego_image, encInfo) == e_success)
+    if (encode_data_to_image(file_extn, strlen(file_extn), encInfo) == e_success)
         return e_success;
     else
         return e_failure;
@@ -291,19 +552,12 @@ Status encode_secret_file_extn(const char *file_extn, EncodeInfo *encInfo)
  * Output: Data is encoded to stego image
  * Return Value: e_success or e_failure
  */
-Status encode_secret_file_size(int file_size, EncodeInfo *encInfo)
+Status encode_secret_file_size(uint64_t file_size, EncodeInfo *encInfo)
 {
-    char str[32];
-    fread(str, sizeof(char), 32, encInfo->fptr_src_image);
-    // passes str and file_size to encode_size_to_lsb
-    if (encode_size_to_lsb(str, file_size) == e_success)
-    {
-        // writes to stego image
-        fwrite(str, sizeof(char), 32, encInfo->fptr_stego_image);
-        return e_success;
-    }
-    else
-        return e_failure;
+    char str[MAX_VARINT_SIZE];
+    // converts file_size to varint and encodes it
+    uint len = encode_varint(file_size, str);
+    return encode_data_to_image(str, len, encInfo);
 }
 
 /* Encode secret file data to stego image
@@ -313,33 +567,140 @@ Status encode_secret_file_size(int file_size, EncodeInfo *encInfo)
  */
 Status encode_secret_file_data(EncodeInfo *encInfo)
 {
-    // a buffer is created with size equal to secret file size
-    char secret_buff[encInfo->size_secret_file];
+    // secret file is streamed in chunks so its size is not limited by memory
+    char *secret_buff = encInfo->secret_data;
+    uint64_t remaining = encInfo->size_secret_file;
     // sets secret file ptr back to the start
-    fseek(encInfo->fptr_secret, 0, SEEK_SET);
-    // reads data to buffer from secret file
-    fread(secret_buff, sizeof(char), encInfo->size_secret_file, encInfo->fptr_secret);
-    // calls encode data to image function
-    if (encode_data_to_image(secret_buff, encInfo->size_secret_file, encInfo->fptr_src_image, encInfo->fptr_stego_image, encInfo) == e_success)
-        return e_success;
-    else
-        return e_failure;
+    fseeko(encInfo->fptr_secret, 0, SEEK_SET);
+    while (remaining > 0)
+    {
+        uint chunk = remaining < MAX_SECRET_CHUNK_SIZE ? remaining : MAX_SECRET_CHUNK_SIZE;
+        // reads data to buffer from secret file
+        if (fread(secret_buff, sizeof(char), chunk, encInfo->fptr_secret) != chunk)
+            return e_failure;
+        // calls encode data to image function
+        if (encode_data_to_image(secret_buff, chunk, encInfo) != e_success)
+            return e_failure;
+        remaining -= chunk;
+    }
+    return e_success;
 }
 
-/* Copy remaining image data to output image 
+#ifdef __linux__
+/* Clone remaining image data as shared extents
+ * Inputs: Src and dest file descriptors, offsets and bytes to copy
+ * Output: Whole filesystem blocks are reflinked (XFS, Btrfs), offsets are advanced
+ * Description: FICLONERANGE needs block aligned offsets, so the bytes upto the
+ * next block boundary are copied first. Both offsets must be at the same
+ * position within a block, which holds as the stego image keeps the src layout
+ */
+static void clone_tail(int fd_src, int fd_dest, off_t *src_off, off_t *dest_off, uint64_t *remaining)
+{
+    struct stat st;
+    if (fstat(fd_src, &st) != 0 || st.st_blksize <= 0 || *src_off % st.st_blksize != *dest_off % st.st_blksize)
+        return;
+    uint64_t head = (st.st_blksize - *src_off % st.st_blksize) % st.st_blksize;
+    if (*remaining <= head)
+        return;
+    // bytes before the block boundary
+    while (head > 0)
+    {
+        ssize_t n = copy_file_range(fd_src, src_off, fd_dest, dest_off, head, 0);
+        if (n <= 0)
+            return;
+        head -= n;
+        *remaining -= n;
+    }
+    // src_length 0 clones till end of src file, which is the whole tail
+    struct file_clone_range range = {.src_fd = fd_src, .src_offset = *src_off, .src_length = 0, .dest_offset = *dest_off};
+    if (ioctl(fd_dest, FICLONERANGE, &range) == 0)
+    {
+        *src_off += *remaining;
+        *dest_off += *remaining;
+        *remaining = 0;
+    }
+}
+#endif
+
+/* Copy remaining image data to output image
  * Inputs: Src and stego image file pointers
- * Output: Remaining image data is copied to stego image
+ * Output: Remaining image data is copied to stego image, trying reflink clone,
+ * copy_file_range, sendfile and then a large buffer read/write loop
  * Return Value: e_success or e_failure
  */
 Status copy_remaining_img_data(FILE *fptr_src, FILE *fptr_dest)
 {
-    // Remaining image data is copied to stego image
-    char ch;
-    while (fread(&ch, sizeof(char), 1, fptr_src) > 0)
+    struct stat st;
+    // kernel copies work on file descriptors, so stdio buffers are flushed first
+    if (fflush(fptr_dest) != 0)
+        return e_failure;
+    int fd_src = fileno(fptr_src), fd_dest = fileno(fptr_dest);
+    off_t src_off = ftello(fptr_src), dest_off = ftello(fptr_dest);
+    if (src_off < 0 || dest_off < 0 || fstat(fd_src, &st) != 0)
+        return e_failure;
+    uint64_t remaining = st.st_size > src_off ? st.st_size - src_off : 0;
+
+#ifdef __linux__
+    clone_tail(fd_src, fd_dest, &src_off, &dest_off, &remaining);
+    // copy_file_range copies inside the kernel, and may reflink by itself
+    while (remaining > 0)
     {
-        fwrite(&ch, sizeof(char), 1, fptr_dest);
+        ssize_t n = copy_file_range(fd_src, &src_off, fd_dest, &dest_off, remaining, 0);
+        if (n <= 0)
+            break;
+        remaining -= n;
     }
-    return e_success;
+    // sendfile writes at the current offset of fd_dest
+    if (remaining > 0 && lseek(fd_dest, dest_off, SEEK_SET) == dest_off)
+    {
+        while (remaining > 0)
+        {
+            ssize_t n = sendfile(fd_dest, fd_src, &src_off, remaining);
+            if (n <= 0)
+                break;
+            dest_off += n;
+            remaining -= n;
+        }
+    }
+#endif
+
+    // Remaining image data is copied to stego image with a large buffer
+    if (remaining > 0)
+    {
+        size_t buff_size = IO_BLOCK_SIZE;
+        char *buff = block_pool_get(shared_block_pool());
+        if (buff == NULL)
+            return e_failure;
+        while (remaining > 0)
+        {
+            ssize_t n = pread(fd_src, buff, remaining < buff_size ? remaining : buff_size, src_off);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                break;
+            for (ssize_t done = 0; done < n;)
+            {
+                ssize_t w = pwrite(fd_dest, buff + done, n - done, dest_off + done);
+                if (w < 0 && errno == EINTR)
+                    continue;
+                if (w <= 0)
+                {
+                    block_pool_put(shared_block_pool(), buff);
+                    return e_failure;
+                }
+                done += w;
+            }
+            src_off += n;
+            dest_off += n;
+            remaining -= n;
+        }
+        block_pool_put(shared_block_pool(), buff);
+    }
+
+    // stdio streams continue after the copied data
+    if (fseeko(fptr_src, src_off, SEEK_SET) != 0 || fseeko(fptr_dest, dest_off, SEEK_SET) != 0)
+        return e_failure;
+    return remaining == 0 ? e_success : e_failure;
 }
 
 /* Do encoding function
@@ -349,6 +710,9 @@ Status copy_remaining_img_data(FILE *fptr_src, FILE *fptr_dest)
  */
 Status do_encoding(EncodeInfo *encInfo)
 {
+    // checkpointed encoding opens its files without truncating the output
+    if (encInfo->resume)
+        return do_encoding_checkpointed(encInfo);
     // Calls each encoding functions one by one and checks if it executed successfully else returns error
     if (open_files(encInfo) == e_success)
     {
@@ -359,16 +723,186 @@ Status do_encoding(EncodeInfo *encInfo)
         printf("ERROR : Opening files failed\n");
         return e_failure;
     }
+    if (strcmp(encInfo->stego_image_fname, STEGO_STDOUT_FNAME) == 0)
+        return do_encoding_to_stream(encInfo);
+    // partial stego image is removed, an older file of the same name is kept
+    Status encoded = encInfo->synthesize ? do_encoding_synthesized(encInfo) : do_encoding_with_files(encInfo);
+    if (encoded != e_success)
+    {
+        durable_abort(&encInfo->stego_file, encInfo->fptr_stego_image);
+        encInfo->fptr_stego_image = NULL;
+        return e_failure;
+    }
+    Status status = durable_commit(&encInfo->stego_file, encInfo->fptr_stego_image, &encInfo->fsync_policy);
+    encInfo->fptr_stego_image = NULL;
+    if (status == e_success)
+    {
+        printf("INFO : Stego image %s is complete\n", encInfo->stego_image_fname);
+    }
+    else
+    {
+        printf("ERROR : Committing stego image %s failed\n", encInfo->stego_image_fname);
+    }
+    return status;
+}
+
+/* Open stego reader
+ * Inputs: encInfo and reader
+ * Output: Reader over the src image, or over a carrier synthesized to fit
+ * the secret with the size asked for
+ * Return Value: e_success or e_failure
+ */
+static Status encode_open_reader(EncodeInfo *encInfo, StegReader *reader)
+{
+    strcpy(encInfo->extn_secret_file, strstr(encInfo->secret_fname, "."));
+    if (!encInfo->synthesize)
+        return steg_reader_open(reader, encInfo->fptr_src_image, encInfo->fptr_secret, encInfo->extn_secret_file);
+    encInfo->size_secret_file = get_file_size(encInfo->fptr_secret);
+    uint64_t payload_bits = get_payload_size(encInfo->extn_secret_file, encInfo->size_secret_file) * 8;
+    if (carrier_synthesize(&encInfo->carrier, encInfo->synth_width, encInfo->synth_height, encInfo->synth_bits_per_pixel, payload_bits) != e_success)
+    {
+        printf("ERROR : Synthesized carrier is too small for the secret or too large for a BMP\n");
+        return e_failure;
+    }
+    printf("INFO : Synthesized %dx%d %u bit carrier of %llu bytes\n", encInfo->carrier.width, encInfo->carrier.height,
+           encInfo->carrier.bits_per_pixel, (unsigned long long)encInfo->carrier.size);
+    return steg_reader_open_synthetic(reader, &encInfo->carrier, carrier_synth_seed(), encInfo->fptr_secret, encInfo->extn_secret_file);
+}
+
+/* Do encoding to a stream
+ * Inputs: encInfo with src image, secret and stego image file pointers
+ * Output: Stego image is pulled from a stego reader block by block and
+ * written to the stego image stream, which may be a pipe or socket
+ * Return Value: e_success or e_failure
+ */
+Status do_encoding_to_stream(EncodeInfo *encInfo)
+{
+    StegReader reader;
+    if (encode_open_reader(encInfo, &reader) == e_success)
+    {
+        printf("INFO : Stego reader is ready\n");
+    }
+    else
+    {
+        printf("ERROR : Opening stego reader failed\n");
+        return e_failure;
+    }
+    char *block = block_pool_get(shared_block_pool());
+    if (block == NULL)
+    {
+        printf("ERROR : Getting stream buffer failed\n");
+        return e_failure;
+    }
+    ssize_t len;
+    while ((len = steg_reader_read(&reader, block, IO_BLOCK_SIZE)) > 0)
+    {
+        if (fwrite(block, 1, len, encInfo->fptr_stego_image) != (size_t)len)
+        {
+            len = -1;
+            break;
+        }
+    }
+    block_pool_put(shared_block_pool(), block);
+    if (len < 0 || fflush(encInfo->fptr_stego_image) != 0)
+    {
+        printf("ERROR : Streaming stego image failed\n");
+        return e_failure;
+    }
+    printf("INFO : Streamed %llu bytes of stego image\n", (unsigned long long)steg_reader_size(&reader));
+    return e_success;
+}
+
+/* Do encoding into a synthesized carrier
+ * Inputs: encInfo with secret and stego image file pointers
+ * Output: Carrier is sized from the secret and generated with the payload
+ * already embedded, block by block, and written through the I/O engine in
+ * the same pass. No carrier bytes are read and the stego image is only as
+ * large as the payload needs
+ * Return Value: e_success or e_failure
+ */
+Status do_encoding_synthesized(EncodeInfo *encInfo)
+{
+    StegReader reader;
+    if (encode_open_reader(encInfo, &reader) == e_success)
+    {
+        printf("INFO : Stego reader is ready\n");
+    }
+    else
+    {
+        printf("ERROR : Opening stego reader failed\n");
+        return e_failure;
+    }
+    char *block = block_pool_get(shared_block_pool());
+    if (block == NULL)
+    {
+        printf("ERROR : Getting job buffers failed\n");
+        return e_failure;
+    }
+    if (io_engine_start(&encInfo->stego_io, encInfo->fptr_stego_image, e_io_write, encInfo->cache_mode) == e_success)
+    {
+        printf("INFO : Started %s I/O engine, %s\n", encInfo->stego_io.backend == e_io_uring ? "io_uring" : "threaded",
+               io_cache_mode_name(encInfo->stego_io.cache_mode));
+    }
+    else
+    {
+        block_pool_put(shared_block_pool(), block);
+        printf("ERROR : Starting I/O engine failed\n");
+        return e_failure;
+    }
+    Status status = e_success;
+    ssize_t len;
+    while ((len = steg_reader_read(&reader, block, IO_BLOCK_SIZE)) > 0)
+    {
+        if (io_engine_write(&encInfo->stego_io, block, len) != e_success)
+        {
+            status = e_failure;
+            break;
+        }
+    }
+    if (len < 0)
+        status = e_failure;
+    block_pool_put(shared_block_pool(), block);
+    if (io_engine_stop(&encInfo->stego_io) != e_success)
+        status = e_failure;
+    if (status != e_success)
+    {
+        printf("ERROR : Writing stego image failed\n");
+        return e_failure;
+    }
+    if (encInfo->cache_mode != e_io_cached)
+    {
+        // unaligned edges went through the page cache
+        fflush(encInfo->fptr_stego_image);
+        io_drop_cache(fileno(encInfo->fptr_stego_image), 0, 0, e_io_write);
+    }
+    printf("INFO : Wrote %llu bytes of stego image, no carrier bytes read\n", (unsigned long long)steg_reader_size(&reader));
+    return e_success;
+}
+
+/* Do encoding on opened files
+ * Inputs: encInfo with src image, secret and stego image file pointers
+ * Output: Calls each encoding functions one by one and checks if it executed successfully
+ * Return Value: e_success or e_failure
+ */
+Status do_encoding_with_files(EncodeInfo *encInfo)
+{
+    if (encode_alloc_buffers(encInfo) != e_success)
+    {
+        printf("ERROR : Getting job buffers failed\n");
+        return e_failure;
+    }
     if (check_capacity(encInfo) == e_success)
     {
         printf("INFO : Check capacity function successfully done\n");
+        if (encInfo->matrix)
+            printf("INFO : Matrix embedding %u bits per %u byte block\n", encInfo->matrix_bits, matrix_block_size(encInfo->matrix_bits));
     }
     else
     {
         printf("ERROR : Check capacity failed\n");
         return e_failure;
     }
-    if (copy_bmp_header(encInfo->fptr_src_image, encInfo->fptr_stego_image) == e_success)
+    if (carrier_copy_header(&encInfo->carrier, encInfo->fptr_src_image, encInfo->fptr_stego_image) == e_success)
     {
         printf("INFO : Copying image header successful\n");
     }
@@ -377,6 +911,84 @@ Status do_encoding(EncodeInfo *encInfo)
         printf("ERROR : Copying image header failed\n");
         return e_failure;
     }
+    if (io_engine_start(&encInfo->src_io, encInfo->fptr_src_image, e_io_read, encInfo->cache_mode) == e_success)
+    {
+        if (io_engine_start(&encInfo->stego_io, encInfo->fptr_stego_image, e_io_write, encInfo->cache_mode) == e_success)
+        {
+            printf("INFO : Started %s I/O engine, %s\n", encInfo->src_io.backend == e_io_uring ? "io_uring" : "threaded",
+                   io_cache_mode_name(encInfo->stego_io.cache_mode));
+        }
+        else
+        {
+            io_engine_stop(&encInfo->src_io);
+            printf("ERROR : Starting I/O engine failed\n");
+            return e_failure;
+        }
+    }
+    else
+    {
+        printf("ERROR : Starting I/O engine failed\n");
+        return e_failure;
+    }
+    // I/O engines are running, embedding below should make no heap call
+    uint64_t heap_calls = mem_heap_calls_thread();
+    Status status = encode_payload(encInfo);
+    encInfo->heap_calls = mem_heap_calls_thread() - heap_calls;
+    // bypassing the page cache, the tail goes through the engines instead of a kernel copy
+    if (status == e_success && encInfo->cache_mode != e_io_cached)
+    {
+        if (encode_copy_tail_io(encInfo) == e_success)
+        {
+            printf("INFO : Copying remaining image data is success\n");
+        }
+        else
+        {
+            printf("ERROR : Copying remaining image data is failed\n");
+            status = e_failure;
+        }
+    }
+    // stops both engines even if one of them or embedding failed
+    Status src_status = io_engine_stop(&encInfo->src_io);
+    if (io_engine_stop(&encInfo->stego_io) == e_success && src_status == e_success)
+    {
+        printf("INFO : Finished pending image I/O\n");
+    }
+    else
+    {
+        printf("ERROR : Finishing pending image I/O failed\n");
+        return e_failure;
+    }
+    if (status != e_success)
+        return e_failure;
+    if (encInfo->cache_mode != e_io_cached)
+    {
+        // header and unaligned edges went through the page cache
+        fflush(encInfo->fptr_stego_image);
+        io_drop_cache(fileno(encInfo->fptr_stego_image), 0, 0, e_io_write);
+        io_drop_cache(fileno(encInfo->fptr_src_image), 0, 0, e_io_read);
+    }
+    else if (copy_remaining_img_data(encInfo->fptr_src_image, encInfo->fptr_stego_image) == e_success)
+    {
+        printf("INFO : Copying remaining image data is success\n");
+    }
+    else
+    {
+        printf("ERROR : Copying remaining image data is failed\n");
+        return e_failure;
+    }
+    return e_success;
+}
+
+/* Encode payload
+ * Inputs: encInfo with both I/O engines running
+ * Output: Magic string, version, secret file extn with its size, secret
+ * file size and data are encoded one by one, stopping at the first failure.
+ * For matrix embedding the code parameter follows the version
+ * Return Value: e_success or e_failure
+ */
+Status encode_payload(EncodeInfo *encInfo)
+{
+    encInfo->matrix_active = 0;
     if (encode_magic_string(MAGIC_STRING, encInfo) == e_success)
     {
         printf("INFO : Encoding Magic string done\n");
@@ -386,13 +998,34 @@ Status do_encoding(EncodeInfo *encInfo)
         printf("ERROR : Encoding Magic string failed\n");
         return e_failure;
     }
-    if (encode_secret_file_extn_size(strlen(encInfo->extn_secret_file), encInfo->fptr_src_image, encInfo->fptr_stego_image) == e_success)
+    if (encode_stego_version(encInfo->matrix ? STEGO_VERSION_MATRIX : STEGO_VERSION, encInfo) == e_success)
+    {
+        printf("INFO : Encoding header version done\n");
+    }
+    else
+    {
+        printf("ERROR : Encoding header version failed\n");
+        return e_failure;
+    }
+    if (encInfo->matrix)
+    {
+        if (encode_matrix_bits(encInfo->matrix_bits, encInfo) == e_success)
+        {
+            printf("INFO : Encoding matrix code done\n");
+        }
+        else
+        {
+            printf("ERROR : Encoding matrix code failed\n");
+            return e_failure;
+        }
+    }
+    if (encode_secret_file_extn_size(strlen(encInfo->extn_secret_file), encInfo) == e_success)
     {
         printf("INFO : Encoding secret file extn size is success\n");
     }
     else
     {
-        printf("ERROR : Encoding secret file extn size is failed\n\n");
+        printf("ERROR : Encoding secret file extn size is failed\n");
         return e_failure;
     }
     if (encode_secret_file_extn(encInfo->extn_secret_file, encInfo) == e_success)
@@ -402,6 +1035,7 @@ Status do_encoding(EncodeInfo *encInfo)
     else
     {
         printf("ERROR : Encoding secret file extn is failed\n");
+        return e_failure;
     }
     if (encode_secret_file_size(encInfo->size_secret_file, encInfo) == e_success)
     {
@@ -410,6 +1044,7 @@ Status do_encoding(EncodeInfo *encInfo)
     else
     {
         printf("ERROR : Encoding secret file size is failed\n");
+        return e_failure;
     }
     if (encode_secret_file_data(encInfo) == e_success)
     {
@@ -418,14 +1053,45 @@ Status do_encoding(EncodeInfo *encInfo)
     else
     {
         printf("ERROR : Encoding secret file data is failed\n");
+        return e_failure;
     }
-    if (copy_remaining_img_data(encInfo->fptr_src_image, encInfo->fptr_stego_image) == e_success)
+    if (encInfo->matrix)
     {
-        printf("INFO : Copying remaining image data is success\n");
+        if (encode_matrix_flush(encInfo) == e_success)
+        {
+            printf("INFO : Matrix embedding changed %llu carrier bytes after the header\n", (unsigned long long)encInfo->matrix_changed);
+        }
+        else
+        {
+            printf("ERROR : Encoding last matrix block failed\n");
+            return e_failure;
+        }
     }
-    else
+    return e_success;
+}
+
+/* Copy remaining image bytes through the I/O engines
+ * Inputs: encInfo with both engines running
+ * Output: Src image is read to the end and written to stego image block by block
+ * Return Value: e_success or e_failure
+ */
+Status encode_copy_tail_io(EncodeInfo *encInfo)
+{
+    char *block = block_pool_get(shared_block_pool());
+    if (block == NULL)
+        return e_failure;
+    Status status = e_success;
+    size_t len;
+    while ((len = io_engine_read(&encInfo->src_io, block, IO_BLOCK_SIZE)) > 0)
     {
-        printf("ERROR : Copying remaining image data is failed\n");
+        if (io_engine_write(&encInfo->stego_io, block, len) != e_success)
+        {
+            status = e_failure;
+            break;
+        }
     }
-    return e_success;
+    if (encInfo->src_io.error)
+        status = e_failure;
+    block_pool_put(shared_block_pool(), block);
+    return status;
 }
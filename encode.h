@@ -2,6 +2,9 @@
 #define ENCODE_H
 
 #include "types.h" // Contains user defined types
+#include "io_engine.h"
+#include "carrier_cache.h"
+#include "durable.h"
 
 /*
  * Structure to store information required for
@@ -13,26 +16,57 @@
 #define MAX_SECRET_BUF_SIZE 1
 #define MAX_IMAGE_BUF_SIZE (MAX_SECRET_BUF_SIZE * 8)
 #define MAX_FILE_SUFFIX 5
+#define MAX_SECRET_CHUNK_SIZE 4096
+/* Stego image name which streams it to stdout */
+#define STEGO_STDOUT_FNAME "-"
+/* Flag for checkpointed encoding, resumed when run again */
+#define ENCODE_RESUME_FLAG "--resume"
 
 typedef struct _EncodeInfo
 {
     /* Source Image info */
     char *src_image_fname;
     FILE *fptr_src_image;
-    uint image_capacity;
+    CarrierInfo carrier;
+    uint64_t image_capacity;
     uint bits_per_pixel;
-    char image_data[MAX_IMAGE_BUF_SIZE];
+    char *image_data;
+
+    /* Synthesized carrier, no src image is read. 0 width or height is sized from the secret */
+    int synthesize;
+    uint64_t synth_width;
+    uint64_t synth_height;
+    uint synth_bits_per_pixel;
 
     /* Secret File Info */
     char *secret_fname;
     FILE *fptr_secret;
     char extn_secret_file[MAX_FILE_SUFFIX];
-    char secret_data[MAX_SECRET_BUF_SIZE];
-    long size_secret_file;
+    char *secret_data;
+    uint64_t size_secret_file;
 
     /* Stego Image Info */
     char *stego_image_fname;
     FILE *fptr_stego_image;
+    DurableFile stego_file;
+    FsyncPolicy fsync_policy;
+    int resume;
+    IoCacheMode cache_mode;
+    /* Heap calls made while embedding the payload, 0 in steady state */
+    uint64_t heap_calls;
+
+    /* Matrix embedding with code parameter p, 0 picks the largest that fits */
+    int matrix;
+    uint matrix_bits;
+    /* Set once the header is embedded, payload bits waiting for a block and bytes changed */
+    int matrix_active;
+    uint32_t matrix_acc;
+    uint matrix_acc_bits;
+    uint64_t matrix_changed;
+
+    /* Async I/O engines for image data after the header */
+    IoEngine src_io;
+    IoEngine stego_io;
 
 } EncodeInfo;
 
@@ -47,46 +81,70 @@ Status read_and_validate_encode_args(char *argv[], EncodeInfo *encInfo);
 /* Perform the encoding */
 Status do_encoding(EncodeInfo *encInfo);
 
+/* Perform the encoding on already opened files */
+Status do_encoding_with_files(EncodeInfo *encInfo);
+
+/* Perform the encoding, streaming stego image from a stego reader */
+Status do_encoding_to_stream(EncodeInfo *encInfo);
+
+/* Perform the encoding into a synthesized carrier, written in one pass */
+Status do_encoding_synthesized(EncodeInfo *encInfo);
+
 /* Get File pointers for i/p and o/p files */
 Status open_files(EncodeInfo *encInfo);
 
+/* Get per job buffers from the job arena */
+Status encode_alloc_buffers(EncodeInfo *encInfo);
+
 /* check capacity */
 Status check_capacity(EncodeInfo *encInfo);
 
-/* Get image size */
-uint get_image_size_for_bmp(FILE *fptr_image);
+/* Get bytes embedded for a secret of given extension and size */
+uint64_t get_payload_size(const char *extn, uint64_t secret_size);
 
 /* Get file size */
-uint get_file_size(FILE *fptr);
-
-/* Copy bmp image header */
-Status copy_bmp_header(FILE *fptr_src_image, FILE *fptr_stego_image);
+uint64_t get_file_size(FILE *fptr);
 
 /* Store Magic String */
 Status encode_magic_string(const char *magic_string, EncodeInfo *encInfo);
 
+/* Store header version */
+Status encode_stego_version(uint version, EncodeInfo *encInfo);
+
+/* Store code parameter of matrix embedding */
+Status encode_matrix_bits(uint bits, EncodeInfo *encInfo);
+
+/* Embed payload bits still waiting for a block */
+Status encode_matrix_flush(EncodeInfo *encInfo);
+
 /* Encode secret file extenstion size */
-Status encode_secret_file_extn_size(int size, FILE *fptr_src_image, FILE *fptr_stego_image);
+Status encode_secret_file_extn_size(uint size, EncodeInfo *encInfo);
 
 /* Encode secret file extenstion */
 Status encode_secret_file_extn(const char *file_extn, EncodeInfo *encInfo);
 
 /* Encode secret file size */
-Status encode_secret_file_size(int file_size, EncodeInfo *encInfo);
+Status encode_secret_file_size(uint64_t file_size, EncodeInfo *encInfo);
 
 /* Encode secret file data*/
 Status encode_secret_file_data(EncodeInfo *encInfo);
 
 /* Encode function, which does the real encoding */
-Status encode_data_to_image(const char *data, int size, FILE *fptr_src_image, FILE *fptr_stego_image, EncodeInfo *encInfo);
+Status encode_data_to_image(const char *data, uint size, EncodeInfo *encInfo);
 
 /* Encode a byte into LSB of image data array */
 Status encode_byte_to_lsb(char data, char *image_buffer);
 
-/* Encode size to LSB of image data */
-Status encode_size_to_lsb(char *buffer, int size);
+/* Encode size as varint, returns number of bytes used */
+uint encode_varint(uint64_t size, char *buffer);
 
 /* Copy remaining image bytes from src to stego image after encoding */
 Status copy_remaining_img_data(FILE *fptr_src, FILE *fptr_dest);
 
+/* Encode magic string, version, extn and size of the secret and its data */
+Status encode_payload(EncodeInfo *encInfo);
+
+/* Copy remaining image bytes through the I/O engines */
+Status encode_copy_tail_io(EncodeInfo *encInfo);
+
 #endif
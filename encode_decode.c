@@ -3,9 +3,25 @@ Name            :   Harikrishnan.H
 Date            :   20-11-2022
 Description     :   LSB Image Steganography on .bmp file
 Sample Input    :   For encoding:
-                    ./a.out -e <image.bmp> <secret file.txt or .c or .sh> <steged image name.bmp (optional)>
+                    ./a.out -e <image.bmp, .ppm, .pgm or .tga> <secret file.txt or .c or .sh> <steged image name.bmp (optional)>
+                    Steged image name - streams it to stdout, messages go to stderr
+                    --synthesize or --synthesize=WxH[x32] in place of the image generates a BMP carrier sized from the secret
+                    --resume after the names checkpoints the encoding, running it again resumes it
+                    --direct after the names bypasses the page cache for the bulk data
+                    --fsync=file or none after the names sets when output is synced to disk
+                    --matrix or --matrix=p after the names embeds p bits per 2^p - 1 bytes, changing at most one of them
                     For decoding:
-                    ./a.out -d <steged image.bmp> <decoded file name.txt or .c or .sh (optional)>
+                    ./a.out -d <steged image.bmp, .ppm, .pgm or .tga> <decoded file name.txt or .c or .sh (optional)>
+                    --direct and --fsync= as for encoding
+                    For daemon mode:
+                    ./a.out -D <socket path> <number of workers (optional)> <placement none, node or core (optional)>
+                    STEGO_FSYNC=batch:N syncs its outputs once every N requests
+                    For steganalysis:
+                    ./a.out --analyze <image.bmp> <region size in KB (optional)> <placement none, node or core (optional)>
+                    For carrier planning:
+                    ./a.out --plan <carrier directory> <secret files.txt or .c or .sh...>
+                    For comparing carrier and steged image:
+                    ./a.out --compare <image.bmp> <steged image.bmp> <tile size in pixels (optional)> <changed bit bitmap file (optional)>
 Sample Output   :   Encoding:
                     Data will be encoded in a .bmp file created as ouput
                     Decoding:
@@ -13,13 +29,20 @@ Sample Output   :   Encoding:
 */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "encode.h"
 #include "decode.h"
+#include "daemon.h"
+#include "analyze.h"
+#include "planner.h"
+#include "compare.h"
 #include "types.h"
 
 int main(int argc, char *argv[])
 {
+    // outputs of an unfinished batch are synced on every exit path
+    atexit(durable_sync_pending);
     // checks if more than 1 command line arguments are passed
     if (argc > 1)
     {
@@ -31,25 +54,34 @@ int main(int argc, char *argv[])
             // checks if atleast 4 or more command line arguments are passed
             if (argc >= 4)
             {
-                printf("INFO : Selected Encoding\n");
                 // Structure to store information required for encoding secret file to source Image
                 EncodeInfo encInfo;
-                // Reads and Validates arguments by calling read_and_validate_encode_args function
+                encInfo.fptr_stego_image = NULL;
+                // Reads and Validates arguments by calling read_and_validate_encode_args function,
+                // a stego image streamed to stdout moves messages to stderr before anything is printed
                 if (read_and_validate_encode_args(argv, &encInfo) == e_success)
                 {
+                    printf("INFO : Selected Encoding\n");
                     printf("INFO : Read and validate function is successfully executed\n");
                     // calls do encoding function and starts encoding, checks if function executed successfully
                     if (do_encoding(&encInfo) == e_success)
                     {
-                        printf("INFO : Encoding completed\n");
-                        // Closing the open files
-                        fclose(encInfo.fptr_src_image);
+                        // Closing the open files, stego image file is already closed unless streamed or checkpointed
+                        if (encInfo.fptr_src_image != NULL)
+                            fclose(encInfo.fptr_src_image);
                         fclose(encInfo.fptr_secret);
-                        fclose(encInfo.fptr_stego_image);
+                        if (encInfo.fptr_stego_image != NULL && fclose(encInfo.fptr_stego_image) != 0)
+                        {
+                            perror("fclose ");
+                            printf("ERROR : Encoding failed\n");
+                            return -1;
+                        }
+                        printf("INFO : Encoding completed\n");
                     }
                     else
                     {
                         printf("ERROR : Encoding failed\n");
+                        return -1;
                     }
                 }
                 else
@@ -83,13 +115,13 @@ int main(int argc, char *argv[])
                     if (do_decoding(&decInfo) == e_success)
                     {
                         printf("INFO : Decoding completed\n");
-                        // Closing the open files
+                        // Closing the open files, output file is already closed
                         fclose(decInfo.fptr_stego_image);
-                        fclose(decInfo.fptr_output);
                     }
                     else
                     {
                         printf("ERROR : Decoding failed\n");
+                        return -1;
                     }
                 }
                 else
@@ -105,11 +137,150 @@ int main(int argc, char *argv[])
                 printf("ERROR : Please pass required command line arguments for decoding\nEg: ./a.out -d stego.bmp\n");
             }
         }
-
+        // If operation is daemon
+        else if (operation == e_daemon)
+        {
+            // checks if atleast 3 or more command line arguments are passed
+            if (argc >= 3)
+            {
+                // Structure to store information required for serving requests
+                DaemonInfo daemon;
+                // Reads and Validates arguments by calling read_and_validate_daemon_args function
+                if (read_and_validate_daemon_args(argv, &daemon) == e_success)
+                {
+                    // runs till SIGINT or SIGTERM
+                    if (do_daemon(&daemon) == e_success)
+                    {
+                        printf("INFO : Daemon stopped\n");
+                    }
+                    else
+                    {
+                        printf("ERROR : Daemon failed\n");
+                        return -1;
+                    }
+                }
+                else
+                {
+                    // prints error if read_and_validate_daemon_args function failed
+                    printf("ERROR : Read and validate function is failure\n");
+                    return -1;
+                }
+            }
+            // else if less than 3 command line arguments are passed
+            else
+            { // Printing error with info on how to pass arguments
+                printf("ERROR : Please pass required command line arguments for daemon mode\nEg: ./a.out -D /tmp/steg.sock\n");
+            }
+        }
+        // If operation is analyze
+        else if (operation == e_analyze)
+        {
+            // checks if atleast 3 or more command line arguments are passed
+            if (argc >= 3)
+            {
+                printf("INFO : Selected Steganalysis\n");
+                // Structure to store information required for analysing an image
+                AnalyzeInfo anaInfo;
+                // Reads and Validates arguments by calling read_and_validate_analyze_args function
+                if (read_and_validate_analyze_args(argv, &anaInfo) == e_success)
+                {
+                    if (do_analysis(&anaInfo) == e_success)
+                    {
+                        printf("INFO : Analysis completed\n");
+                    }
+                    else
+                    {
+                        printf("ERROR : Analysis failed\n");
+                        return -1;
+                    }
+                }
+                else
+                {
+                    // prints error if read_and_validate_analyze_args function failed
+                    printf("ERROR : Read and validate function is failure\n");
+                    return -1;
+                }
+            }
+            // else if less than 3 command line arguments are passed
+            else
+            { // Printing error with info on how to pass arguments
+                printf("ERROR : Please pass required command line arguments for analysis\nEg: ./a.out --analyze stego.bmp\n");
+            }
+        }
+        // If operation is plan
+        else if (operation == e_plan)
+        {
+            // checks if atleast 4 or more command line arguments are passed
+            if (argc >= 4)
+            {
+                printf("INFO : Selected Carrier Planning\n");
+                // Structure to store carrier index and payloads to place
+                PlannerInfo planInfo;
+                // Reads and Validates arguments by calling read_and_validate_plan_args function
+                if (read_and_validate_plan_args(argc, argv, &planInfo) == e_success)
+                {
+                    if (do_planning(&planInfo) == e_success)
+                    {
+                        printf("INFO : Planning completed\n");
+                    }
+                    else
+                    {
+                        printf("ERROR : Planning failed\n");
+                        return -1;
+                    }
+                }
+                else
+                {
+                    // prints error if read_and_validate_plan_args function failed
+                    printf("ERROR : Read and validate function is failure\n");
+                    return -1;
+                }
+            }
+            // else if less than 4 command line arguments are passed
+            else
+            { // Printing error with info on how to pass arguments
+                printf("ERROR : Please pass required command line arguments for planning\nEg: ./a.out --plan carriers/ secret.txt\n");
+            }
+        }
+        // If operation is compare
+        else if (operation == e_compare)
+        {
+            // checks if atleast 4 or more command line arguments are passed
+            if (argc >= 4)
+            {
+                printf("INFO : Selected Comparison\n");
+                // Structure to store information required for comparing a carrier with its steged image
+                CompareInfo cmpInfo;
+                // Reads and Validates arguments by calling read_and_validate_compare_args function
+                if (read_and_validate_compare_args(argv, &cmpInfo) == e_success)
+                {
+                    if (do_compare(&cmpInfo) == e_success)
+                    {
+                        printf("INFO : Comparison completed\n");
+                    }
+                    else
+                    {
+                        printf("ERROR : Comparison failed\n");
+                        return -1;
+                    }
+                }
+                else
+                {
+                    // prints error if read_and_validate_compare_args function failed
+                    printf("ERROR : Read and validate function is failure\n");
+                    return -1;
+                }
+            }
+            // else if less than 4 command line arguments are passed
+            else
+            { // Printing error with info on how to pass arguments
+                printf("ERROR : Please pass required command line arguments for comparison\nEg: ./a.out --compare beautiful.bmp stego.bmp\n");
+            }
+        }
         else
         {
             // Prints error if operation is not passed correctly
-            printf("ERROR : Operation is Invalid.\nPlease pass -e for encoding and -d for decoding\n");
+            printf("ERROR : Operation is Invalid.\nPlease pass -e for encoding, -d for decoding, -D for daemon mode, --analyze for steganalysis, --plan for carrier planning and --compare for comparing images\n");
         }
     }
     // else if only 1 command line argument is passed
@@ -124,8 +295,8 @@ int main(int argc, char *argv[])
 
 /* Check the operation type mentioned by user
  * Input: Command line arguments
- * Output: Operation to do is identified ie.., encode or decode
- * Return: e_decode or e_encode or e_unsupported, if invalid operation
+ * Output: Operation to do is identified ie.., encode, decode, daemon, analyze, plan or compare
+ * Return: e_decode or e_encode or e_daemon or e_analyze or e_plan or e_compare or e_unsupported, if invalid operation
  */
 OperationType check_operation_type(char *argv[])
 {
@@ -134,6 +305,14 @@ OperationType check_operation_type(char *argv[])
         return e_encode;
     else if (strcmp(argv[1], "-d") == 0)
         return e_decode;
+    else if (strcmp(argv[1], "-D") == 0)
+        return e_daemon;
+    else if (strcmp(argv[1], "--analyze") == 0)
+        return e_analyze;
+    else if (strcmp(argv[1], "--plan") == 0)
+        return e_plan;
+    else if (strcmp(argv[1], "--compare") == 0)
+        return e_compare;
     else
         return e_unsupported;
 }
@@ -0,0 +1,629 @@
+// 64 bit file offsets so multi-GB carriers and payloads work
+#define _FILE_OFFSET_BITS 64
+// O_DIRECT and sync_file_range
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "io_engine.h"
+#include "mem_pool.h"
+#include "types.h"
+
+#ifdef HAVE_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+/* Function Definitions */
+
+/* Finish a block synchronously
+ * Inputs: io, ring slot and bytes already transferred by the backend
+ * Output: Remaining bytes of the block are read or written with pread/pwrite.
+ * A block not started yet goes through its own descriptor, which may be
+ * O_DIRECT, the unaligned rest of a short transfer through the normal one
+ * Return Value: Bytes transferred or -errno
+ */
+static long io_finish_block(IoEngine *io, uint slot, long result)
+{
+    if (result < 0)
+        return result;
+    size_t done = result;
+    int fd = done == 0 ? io->block_fd[slot] : io->fd;
+    while (done < io->block_len[slot])
+    {
+        ssize_t n;
+        if (io->direction == e_io_read)
+            n = pread(fd, io->block_buf[slot] + done, io->block_len[slot] - done, io->block_offset[slot] + done);
+        else
+            n = pwrite(fd, io->block_buf[slot] + done, io->block_len[slot] - done, io->block_offset[slot] + done);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            // O_DIRECT refused the transfer, eg. stricter alignment
+            if (fd != io->fd)
+            {
+                fd = io->fd;
+                continue;
+            }
+            return -errno;
+        }
+        // file got shorter than expected
+        if (n == 0)
+            break;
+        done += n;
+        fd = io->fd;
+    }
+    return done;
+}
+
+/* Write a range synchronously
+ * Inputs: File descriptor, data, size and offset
+ * Return Value: e_success or e_failure
+ */
+static Status io_write_range(int fd, const char *data, size_t size, uint64_t offset)
+{
+    while (size > 0)
+    {
+        ssize_t n = pwrite(fd, data, size, offset);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return e_failure;
+        data += n;
+        size -= n;
+        offset += n;
+    }
+    return e_success;
+}
+
+/* Write back and drop cached pages
+ * Inputs: File descriptor, range, 0 length meaning till end of file, and
+ * whether the range was read or written
+ * Output: Dirty pages are written back first, as they can not be dropped
+ */
+void io_drop_cache(int fd, uint64_t offset, uint64_t len, IoDirection direction)
+{
+#ifdef __linux__
+    if (direction == e_io_write)
+        sync_file_range(fd, offset, len, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+#endif
+    posix_fadvise(fd, offset, len, POSIX_FADV_DONTNEED);
+}
+
+/* Write behind
+ * Inputs: io and end of the data written so far
+ * Output: Writeback of the new data is started, the range started on the
+ * previous call is waited for and its pages dropped, so the cache holds
+ * about two blocks of the file
+ */
+static void io_write_behind(IoEngine *io, uint64_t end)
+{
+    if (end <= io->writeback_offset)
+        return;
+#ifdef __linux__
+    sync_file_range(io->fd, io->writeback_offset, end - io->writeback_offset, SYNC_FILE_RANGE_WRITE);
+#endif
+    if (io->writeback_offset > io->dropped_offset)
+        io_drop_cache(io->fd, io->dropped_offset, io->writeback_offset - io->dropped_offset, e_io_write);
+    io->dropped_offset = io->writeback_offset;
+    io->writeback_offset = end;
+}
+
+/* Name of a cache mode
+ * Input: Cache mode
+ * Return Value: Name printed with the backend
+ */
+const char *io_cache_mode_name(IoCacheMode cache_mode)
+{
+    if (cache_mode == e_io_direct)
+        return "O_DIRECT";
+    if (cache_mode == e_io_dontneed)
+        return "write-behind, pages dropped";
+    return "page cache";
+}
+
+/* Helper thread of the thread backend
+ * Input: io
+ * Output: Submitted blocks are transferred in order till the engine is stopped
+ */
+static void *io_thread_main(void *arg)
+{
+    IoEngine *io = arg;
+    pthread_mutex_lock(&io->lock);
+    while (1)
+    {
+        while (io->completed == io->submitted && !io->stop)
+            pthread_cond_wait(&io->cond, &io->lock);
+        if (io->completed == io->submitted)
+            break;
+        uint slot = io->completed % IO_RING_BLOCKS;
+        pthread_mutex_unlock(&io->lock);
+        long result = io_finish_block(io, slot, 0);
+        pthread_mutex_lock(&io->lock);
+        io->block_result[slot] = result;
+        io->completed++;
+        pthread_cond_broadcast(&io->cond);
+    }
+    pthread_mutex_unlock(&io->lock);
+    return NULL;
+}
+
+#ifdef HAVE_IO_URING
+/* Release io_uring rings
+ * Input: io
+ */
+static void io_uring_teardown(IoEngine *io)
+{
+    if (io->sqes != NULL)
+        munmap(io->sqes, io->sqes_size);
+    if (io->cq_ptr != NULL && io->cq_ptr != io->sq_ptr)
+        munmap(io->cq_ptr, io->cq_size);
+    if (io->sq_ptr != NULL)
+        munmap(io->sq_ptr, io->sq_size);
+    close(io->uring_fd);
+}
+
+/* Set up io_uring with one submission entry per ring block
+ * Input: io
+ * Output: Submission and completion rings are mapped
+ * Return Value: e_success or e_failure, if kernel has no io_uring
+ */
+static Status io_uring_init(IoEngine *io)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    io->uring_fd = syscall(__NR_io_uring_setup, IO_RING_BLOCKS, &params);
+    if (io->uring_fd < 0)
+        return e_failure;
+
+    io->sq_size = params.sq_off.array + params.sq_entries * sizeof(uint);
+    io->cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    // both rings share one mapping on newer kernels
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (io->cq_size > io->sq_size)
+            io->sq_size = io->cq_size;
+        io->cq_size = io->sq_size;
+    }
+    io->sq_ptr = mmap(NULL, io->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, io->uring_fd, IORING_OFF_SQ_RING);
+    if (io->sq_ptr == MAP_FAILED)
+    {
+        io->sq_ptr = NULL;
+        io_uring_teardown(io);
+        return e_failure;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        io->cq_ptr = io->sq_ptr;
+    else
+    {
+        io->cq_ptr = mmap(NULL, io->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, io->uring_fd, IORING_OFF_CQ_RING);
+        if (io->cq_ptr == MAP_FAILED)
+        {
+            io->cq_ptr = NULL;
+            io_uring_teardown(io);
+            return e_failure;
+        }
+    }
+    io->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    io->sqes = mmap(NULL, io->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, io->uring_fd, IORING_OFF_SQES);
+    if (io->sqes == MAP_FAILED)
+    {
+        io->sqes = NULL;
+        io_uring_teardown(io);
+        return e_failure;
+    }
+
+    io->sq_tail = (uint *)((char *)io->sq_ptr + params.sq_off.tail);
+    io->sq_mask = (uint *)((char *)io->sq_ptr + params.sq_off.ring_mask);
+    io->sq_array = (uint *)((char *)io->sq_ptr + params.sq_off.array);
+    io->cq_head = (uint *)((char *)io->cq_ptr + params.cq_off.head);
+    io->cq_tail = (uint *)((char *)io->cq_ptr + params.cq_off.tail);
+    io->cq_mask = (uint *)((char *)io->cq_ptr + params.cq_off.ring_mask);
+    io->cqes = (char *)io->cq_ptr + params.cq_off.cqes;
+    return e_success;
+}
+#endif
+
+/* Submit a ring block to the backend
+ * Inputs: io and ring slot with offset and length filled
+ * Output: Block transfer is started
+ * Return Value: e_success or e_failure
+ */
+static Status io_submit_block(IoEngine *io, uint slot)
+{
+    io->block_done[slot] = 0;
+#ifdef HAVE_IO_URING
+    if (io->backend == e_io_uring)
+    {
+        uint tail = *io->sq_tail;
+        uint index = tail & *io->sq_mask;
+        struct io_uring_sqe *sqe = &((struct io_uring_sqe *)io->sqes)[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = io->direction == e_io_read ? IORING_OP_READ : IORING_OP_WRITE;
+        sqe->fd = io->block_fd[slot];
+        sqe->addr = (unsigned long)io->block_buf[slot];
+        sqe->len = io->block_len[slot];
+        sqe->off = io->block_offset[slot];
+        sqe->user_data = slot;
+        io->sq_array[index] = index;
+        __atomic_store_n(io->sq_tail, tail + 1, __ATOMIC_RELEASE);
+        while (syscall(__NR_io_uring_enter, io->uring_fd, 1, 0, 0, NULL, 0) < 0)
+        {
+            if (errno != EINTR)
+                return e_failure;
+        }
+        io->submitted++;
+        return e_success;
+    }
+#endif
+    pthread_mutex_lock(&io->lock);
+    io->submitted++;
+    pthread_cond_broadcast(&io->cond);
+    pthread_mutex_unlock(&io->lock);
+    return e_success;
+}
+
+/* Wait for a submitted block
+ * Inputs: io and sequence number of the block
+ * Output: block_result of its slot holds bytes transferred or -errno
+ * Return Value: e_success or e_failure, if waiting itself failed
+ */
+static Status io_wait_block(IoEngine *io, uint64_t seq)
+{
+    uint slot = seq % IO_RING_BLOCKS;
+#ifdef HAVE_IO_URING
+    if (io->backend == e_io_uring)
+    {
+        while (!io->block_done[slot])
+        {
+            uint head = *io->cq_head;
+            uint tail = __atomic_load_n(io->cq_tail, __ATOMIC_ACQUIRE);
+            if (head == tail)
+            {
+                if (syscall(__NR_io_uring_enter, io->uring_fd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0 && errno != EINTR)
+                    return e_failure;
+                continue;
+            }
+            // reap every completion, they may arrive out of order
+            while (head != tail)
+            {
+                struct io_uring_cqe *cqe = &((struct io_uring_cqe *)io->cqes)[head & *io->cq_mask];
+                uint done_slot = cqe->user_data;
+                // failed or short transfers are finished synchronously
+                io->block_result[done_slot] = io_finish_block(io, done_slot, cqe->res < 0 ? 0 : cqe->res);
+                io->block_done[done_slot] = 1;
+                head++;
+            }
+            __atomic_store_n(io->cq_head, head, __ATOMIC_RELEASE);
+        }
+        return e_success;
+    }
+#endif
+    pthread_mutex_lock(&io->lock);
+    while (io->completed <= seq)
+        pthread_cond_wait(&io->cond, &io->lock);
+    pthread_mutex_unlock(&io->lock);
+    return e_success;
+}
+
+/* Give ring blocks back to the shared block pool
+ * Input: io
+ */
+static void io_free_ring(IoEngine *io)
+{
+    for (uint i = 0; i < IO_RING_BLOCKS; i++)
+        block_pool_put(shared_block_pool(), io->ring[i]);
+    memset(io->ring, 0, sizeof(io->ring));
+    if (io->fd_direct >= 0)
+        close(io->fd_direct);
+    io->fd_direct = -1;
+}
+
+/* Queue read ahead of the next block of the file
+ * Input: io
+ * Return Value: e_success or e_failure
+ */
+static Status io_queue_read(IoEngine *io)
+{
+    uint slot = io->submitted % IO_RING_BLOCKS;
+    uint64_t remaining = io->end_offset - io->next_offset;
+    io->block_offset[slot] = io->next_offset;
+    io->block_len[slot] = remaining < IO_BLOCK_SIZE ? remaining : IO_BLOCK_SIZE;
+    io->block_buf[slot] = io->ring[slot];
+    io->block_fd[slot] = io->fd;
+    // O_DIRECT reads whole aligned blocks, the last one ends short at end of file
+    if (io->cache_mode == e_io_direct)
+    {
+        io->block_len[slot] = (io->block_len[slot] + MEM_ALIGN - 1) & ~(size_t)(MEM_ALIGN - 1);
+        io->block_fd[slot] = io->fd_direct;
+    }
+    io->next_offset += io->block_len[slot];
+    return io_submit_block(io, slot);
+}
+
+/* Queue write of the block being filled by the caller
+ * Input: io
+ * Return Value: e_success or e_failure
+ */
+static Status io_queue_write(IoEngine *io)
+{
+    uint slot = io->head % IO_RING_BLOCKS;
+    uint64_t offset = io->next_offset;
+    char *buffer = io->ring[slot] + io->lead;
+    size_t len = io->cur_len;
+    io->next_offset += io->cur_len;
+    io->holding = 0;
+    io->head++;
+    io->lead = 0;
+    io->block_fd[slot] = io->fd;
+    if (io->cache_mode == e_io_direct)
+    {
+        uint64_t start = (offset + MEM_ALIGN - 1) & ~(uint64_t)(MEM_ALIGN - 1);
+        uint64_t end = (offset + len) & ~(uint64_t)(MEM_ALIGN - 1);
+        if (start < end)
+        {
+            // unaligned edges, after the header and at the end, go through the normal descriptor
+            if (io_write_range(io->fd, buffer, start - offset, offset) != e_success ||
+                io_write_range(io->fd, buffer + (end - offset), offset + len - end, end) != e_success)
+                return e_failure;
+            buffer += start - offset;
+            len = end - start;
+            offset = start;
+            io->block_fd[slot] = io->fd_direct;
+        }
+    }
+    io->block_offset[slot] = offset;
+    io->block_len[slot] = len;
+    io->block_buf[slot] = buffer;
+    return io_submit_block(io, slot);
+}
+
+/* Start I/O engine
+ * Inputs: io, file pointer, direction and cache mode
+ * Output: Ring buffers are allocated and, for reading, read ahead is started
+ * from the current position of fptr. For O_DIRECT the file is opened again
+ * with O_DIRECT, if that fails pages are dropped behind the engine instead
+ * Return Value: e_success or e_failure
+ */
+Status io_engine_start(IoEngine *io, FILE *fptr, IoDirection direction, IoCacheMode cache_mode)
+{
+    struct stat st;
+    memset(io, 0, sizeof(*io));
+    io->fptr = fptr;
+    io->fd = fileno(fptr);
+    io->fd_direct = -1;
+    io->direction = direction;
+
+    // engine works on the file descriptor, so stdio buffers are flushed first
+    if (direction == e_io_write && fflush(fptr) != 0)
+        return e_failure;
+    off_t offset = ftello(fptr);
+    if (offset < 0 || fstat(io->fd, &st) != 0)
+        return e_failure;
+    io->next_offset = io->position = offset;
+    io->end_offset = st.st_size;
+    io->writeback_offset = io->dropped_offset = offset;
+
+    io->cache_mode = cache_mode;
+    if (cache_mode == e_io_direct)
+    {
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/self/fd/%d", io->fd);
+        io->fd_direct = open(path, (direction == e_io_read ? O_RDONLY : O_WRONLY) | O_DIRECT | O_CLOEXEC);
+        if (io->fd_direct < 0)
+            io->cache_mode = e_io_dontneed;
+    }
+    // blocks are aligned to the file, the first one starts at the offset before the data
+    if (io->cache_mode == e_io_direct)
+    {
+        io->lead = offset % MEM_ALIGN;
+        if (direction == e_io_read)
+            io->next_offset -= io->lead;
+    }
+    if (io->cache_mode == e_io_dontneed && direction == e_io_read)
+        posix_fadvise(io->fd, offset, 0, POSIX_FADV_SEQUENTIAL);
+
+    for (uint i = 0; i < IO_RING_BLOCKS; i++)
+    {
+        // blocks are reused across jobs, only the first jobs allocate them
+        io->ring[i] = block_pool_get(shared_block_pool());
+        if (io->ring[i] == NULL)
+        {
+            io_free_ring(io);
+            return e_failure;
+        }
+    }
+
+#ifdef HAVE_IO_URING
+    if (io_uring_init(io) == e_success)
+        io->backend = e_io_uring;
+    else
+#endif
+    {
+        io->backend = e_io_thread;
+        pthread_mutex_init(&io->lock, NULL);
+        pthread_cond_init(&io->cond, NULL);
+        if (pthread_create(&io->thread, NULL, io_thread_main, io) != 0)
+        {
+            pthread_cond_destroy(&io->cond);
+            pthread_mutex_destroy(&io->lock);
+            io_free_ring(io);
+            return e_failure;
+        }
+    }
+
+    // keeps every block of the ring reading ahead
+    if (direction == e_io_read)
+    {
+        while (io->submitted < IO_RING_BLOCKS && io->next_offset < io->end_offset)
+        {
+            if (io_queue_read(io) != e_success)
+            {
+                io->error = 1;
+                break;
+            }
+        }
+    }
+    return e_success;
+}
+
+/* Read from I/O engine
+ * Inputs: io, destination buffer and size
+ * Output: Data is copied from read ahead blocks, used up blocks are queued again
+ * Return Value: Bytes read, less than size at end of file or on error
+ */
+size_t io_engine_read(IoEngine *io, char *buffer, size_t size)
+{
+    size_t done = 0;
+    while (done < size && !io->error)
+    {
+        if (io->holding && io->cur_pos == io->cur_len)
+        {
+            // current block is used up, its slot reads ahead the next block
+            uint slot = io->head % IO_RING_BLOCKS;
+            if (io->cache_mode == e_io_dontneed)
+            {
+                posix_fadvise(io->fd, io->block_offset[slot], io->block_len[slot], POSIX_FADV_DONTNEED);
+                io->dropped_offset = io->block_offset[slot] + io->block_len[slot];
+            }
+            io->holding = 0;
+            io->head++;
+            if (io->next_offset < io->end_offset && io_queue_read(io) != e_success)
+            {
+                io->error = 1;
+                break;
+            }
+        }
+        if (!io->holding)
+        {
+            // end of file
+            if (io->head == io->submitted)
+                break;
+            uint slot = io->head % IO_RING_BLOCKS;
+            if (io_wait_block(io, io->head) != e_success || io->block_result[slot] < 0)
+            {
+                io->error = 1;
+                break;
+            }
+            io->cur_len = io->block_result[slot];
+            // first aligned block holds bytes before the start offset
+            io->cur_pos = io->lead < io->cur_len ? io->lead : io->cur_len;
+            io->lead = 0;
+            io->holding = 1;
+            if (io->cur_len == 0)
+                break;
+        }
+        size_t n = io->cur_len - io->cur_pos;
+        if (n > size - done)
+            n = size - done;
+        memcpy(buffer + done, io->ring[io->head % IO_RING_BLOCKS] + io->cur_pos, n);
+        io->cur_pos += n;
+        io->position += n;
+        done += n;
+    }
+    return done;
+}
+
+/* Write to I/O engine
+ * Inputs: io, source buffer and size
+ * Output: Data is copied to the current block, full blocks are queued for writing
+ * Return Value: e_success or e_failure
+ */
+Status io_engine_write(IoEngine *io, const char *buffer, size_t size)
+{
+    while (size > 0)
+    {
+        if (io->error)
+            return e_failure;
+        if (!io->holding)
+        {
+            // slot is free again once the write queued a ring ago has completed
+            if (io->head >= IO_RING_BLOCKS)
+            {
+                uint64_t seq = io->head - IO_RING_BLOCKS;
+                uint slot = seq % IO_RING_BLOCKS;
+                if (io_wait_block(io, seq) != e_success || io->block_result[slot] != (long)io->block_len[slot])
+                {
+                    io->error = 1;
+                    return e_failure;
+                }
+                if (io->cache_mode == e_io_dontneed)
+                    io_write_behind(io, io->block_offset[slot] + io->block_len[slot]);
+            }
+            io->cur_len = 0;
+            io->holding = 1;
+        }
+        size_t n = IO_BLOCK_SIZE - io->lead - io->cur_len;
+        if (n > size)
+            n = size;
+        memcpy(io->ring[io->head % IO_RING_BLOCKS] + io->lead + io->cur_len, buffer, n);
+        io->cur_len += n;
+        io->position += n;
+        buffer += n;
+        size -= n;
+        if (io->lead + io->cur_len == IO_BLOCK_SIZE && io_queue_write(io) != e_success)
+        {
+            io->error = 1;
+            return e_failure;
+        }
+    }
+    return e_success;
+}
+
+/* Stop I/O engine
+ * Input: io
+ * Output: Pending writes are finished, buffers are released and fptr is
+ * positioned right after the data read or written through the engine
+ * Return Value: e_success or e_failure, if any transfer failed
+ */
+Status io_engine_stop(IoEngine *io)
+{
+    int failed = io->error;
+    // queues the partly filled block
+    if (io->direction == e_io_write && io->holding && io->cur_len > 0 && io_queue_write(io) != e_success)
+        failed = 1;
+
+    // every block in flight is waited for, the kernel may still be using it
+    uint64_t seq = io->submitted > IO_RING_BLOCKS ? io->submitted - IO_RING_BLOCKS : 0;
+    for (; seq < io->submitted; seq++)
+    {
+        uint slot = seq % IO_RING_BLOCKS;
+        if (io_wait_block(io, seq) != e_success)
+            failed = 1;
+        else if (io->direction == e_io_write && io->block_result[slot] != (long)io->block_len[slot])
+            failed = 1;
+    }
+
+    // pages left behind the engine are dropped, for reading including read ahead
+    uint64_t end = io->direction == e_io_read ? io->next_offset : io->position;
+    if (io->cache_mode == e_io_dontneed && end > io->dropped_offset)
+        io_drop_cache(io->fd, io->dropped_offset, end - io->dropped_offset, io->direction);
+
+#ifdef HAVE_IO_URING
+    if (io->backend == e_io_uring)
+        io_uring_teardown(io);
+#endif
+    if (io->backend == e_io_thread)
+    {
+        pthread_mutex_lock(&io->lock);
+        io->stop = 1;
+        pthread_cond_broadcast(&io->cond);
+        pthread_mutex_unlock(&io->lock);
+        pthread_join(io->thread, NULL);
+        pthread_cond_destroy(&io->cond);
+        pthread_mutex_destroy(&io->lock);
+    }
+    io_free_ring(io);
+
+    // stdio stream continues where the engine stopped
+    if (fseeko(io->fptr, io->position, SEEK_SET) != 0)
+        failed = 1;
+    return failed ? e_failure : e_success;
+}
@@ -0,0 +1,133 @@
+#ifndef IO_ENGINE_H
+#define IO_ENGINE_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include "types.h" // Contains user defined types
+
+/*
+ * Asynchronous block I/O engine used to overlap
+ * reading the carrier, embedding and writing the
+ * stego image. Several large blocks are kept in
+ * flight while the caller works on the current one.
+ * io_uring is used when the kernel supports it, else
+ * a helper thread does pread/pwrite over the same ring.
+ * Bulk jobs can bypass the page cache: with O_DIRECT the
+ * aligned part of every block goes through a second
+ * descriptor opened with O_DIRECT and unaligned edges
+ * through the normal one. Where O_DIRECT is not
+ * supported, pages are written back with sync_file_range
+ * behind the engine and dropped with posix_fadvise
+ */
+
+#if defined(__linux__) && !defined(NO_IO_URING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING
+#endif
+#endif
+
+#define IO_BLOCK_SIZE (1 << 20)
+#define IO_RING_BLOCKS 4
+/* Command line flag selecting e_io_direct */
+#define IO_DIRECT_FLAG "--direct"
+
+typedef enum
+{
+    e_io_read,
+    e_io_write
+} IoDirection;
+
+typedef enum
+{
+    e_io_uring,
+    e_io_thread
+} IoBackend;
+
+/* Page cache use, e_io_direct falls back to e_io_dontneed */
+typedef enum
+{
+    e_io_cached,
+    e_io_direct,
+    e_io_dontneed
+} IoCacheMode;
+
+typedef struct _IoEngine
+{
+    /* File being read or written */
+    FILE *fptr;
+    int fd;
+    IoDirection direction;
+    IoBackend backend;
+    uint64_t end_offset;
+    uint64_t next_offset;
+    uint64_t position;
+
+    /* Ring of blocks, slot of sequence number n is n % IO_RING_BLOCKS */
+    char *ring[IO_RING_BLOCKS];
+    char *block_buf[IO_RING_BLOCKS];
+    int block_fd[IO_RING_BLOCKS];
+    uint64_t block_offset[IO_RING_BLOCKS];
+    size_t block_len[IO_RING_BLOCKS];
+    long block_result[IO_RING_BLOCKS];
+    int block_done[IO_RING_BLOCKS];
+    uint64_t submitted;
+
+    /* Block the caller is working on */
+    uint64_t head;
+    int holding;
+    size_t cur_pos;
+    size_t cur_len;
+    int error;
+
+    /* Page cache bypass, lead is the offset of the first byte in the first block */
+    IoCacheMode cache_mode;
+    int fd_direct;
+    size_t lead;
+    uint64_t writeback_offset;
+    uint64_t dropped_offset;
+
+    /* io_uring backend */
+    int uring_fd;
+    void *sq_ptr;
+    size_t sq_size;
+    void *cq_ptr;
+    size_t cq_size;
+    void *sqes;
+    size_t sqes_size;
+    uint *sq_tail;
+    uint *sq_mask;
+    uint *sq_array;
+    uint *cq_head;
+    uint *cq_tail;
+    uint *cq_mask;
+    void *cqes;
+
+    /* Thread backend */
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint64_t completed;
+    int stop;
+} IoEngine;
+
+/* I/O engine function prototype */
+
+/* Start engine at the current position of fptr */
+Status io_engine_start(IoEngine *io, FILE *fptr, IoDirection direction, IoCacheMode cache_mode);
+
+/* Read upto size bytes, returns bytes read */
+size_t io_engine_read(IoEngine *io, char *buffer, size_t size);
+
+/* Queue size bytes for writing */
+Status io_engine_write(IoEngine *io, const char *buffer, size_t size);
+
+/* Finish pending I/O and leave fptr positioned after the data read or written */
+Status io_engine_stop(IoEngine *io);
+
+/* Write back and drop cached pages of a file range */
+void io_drop_cache(int fd, uint64_t offset, uint64_t len, IoDirection direction);
+
+/* Name of a cache mode */
+const char *io_cache_mode_name(IoCacheMode cache_mode);
+
+#endif
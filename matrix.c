@@ -0,0 +1,131 @@
+// 64 bit file offsets so multi-GB carriers and payloads work
+#define _FILE_OFFSET_BITS 64
+
+#include <string.h>
+#include "matrix.h"
+#include "types.h"
+
+/* Function Definitions */
+
+/* Bytes in a block
+ * Input: Code parameter p
+ * Return Value: 2^p - 1
+ */
+uint matrix_block_size(uint bits)
+{
+    return (1u << bits) - 1;
+}
+
+/* Carrier bytes used by a payload
+ * Inputs: Code parameter and payload size as get_payload_size gives it
+ * Output: Header bytes take 8 carrier bytes each, the code parameter byte
+ * included, the rest takes a block for every p bits, the last block padded
+ * Return Value: Carrier bytes from the start of the pixel data
+ */
+uint64_t matrix_carrier_bytes(uint bits, uint64_t payload_size)
+{
+    // magic string and version are part of payload_size, the code parameter is not
+    uint64_t coded_bits = (payload_size - (MATRIX_HEADER_SIZE - 1)) * 8;
+    return MATRIX_HEADER_SIZE * 8 + (coded_bits + bits - 1) / bits * matrix_block_size(bits);
+}
+
+/* Largest code fitting a carrier
+ * Inputs: Carrier capacity and payload size as get_payload_size gives it
+ * Output: Fewest bytes are changed with the largest p, which has the
+ * longest blocks
+ * Return Value: Code parameter, or 0 if even the smallest code does not fit
+ */
+uint matrix_best_bits(uint64_t capacity, uint64_t payload_size)
+{
+    for (uint bits = MATRIX_MAX_BITS; bits >= MATRIX_MIN_BITS; bits--)
+    {
+        if (capacity > matrix_carrier_bytes(bits, payload_size))
+            return bits;
+    }
+    return 0;
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+/* Syndrome of a block, 8 bytes at a time
+ * Inputs: Block of carrier bytes and its size, at least MATRIX_GROUP - 1
+ * Output: Block covers whole groups of 64 positions, position 0 being
+ * empty. Low 6 bits of a position are its place in the group, so their XOR
+ * is a parity of the LSBs XORed over all groups. High bits are the group
+ * number, taken when the group has an odd number of LSBs set. Byte k of a
+ * word is the k-th byte in memory only on little endian hosts
+ * Return Value: Bits embedded in the block
+ */
+static uint matrix_syndrome_words(const char *block, uint block_size)
+{
+    // group 0 starts at the empty position 0, the first word gets an empty byte
+    uint syndrome = 0;
+    uint64_t lsb[MATRIX_GROUP / 8];
+    memcpy(&lsb[0], block, 8);
+    lsb[0] = lsb[0] << 8 & 0x0101010101010101ULL;
+    for (uint i = 1; i < MATRIX_GROUP / 8; i++)
+    {
+        memcpy(&lsb[i], block + i * 8 - 1, 8);
+        lsb[i] &= 0x0101010101010101ULL;
+    }
+    for (uint group = 1; group < (block_size + 1) / MATRIX_GROUP; group++)
+    {
+        const char *bytes = block + group * MATRIX_GROUP - 1;
+        uint64_t parity = 0;
+        for (uint i = 0; i < MATRIX_GROUP / 8; i++)
+        {
+            uint64_t word;
+            memcpy(&word, bytes + i * 8, 8);
+            word &= 0x0101010101010101ULL;
+            lsb[i] ^= word;
+            parity ^= word;
+        }
+        syndrome ^= (group * MATRIX_GROUP) & -(uint)__builtin_parityll(parity);
+    }
+    // position in a word, byte k of every word, then the word itself
+    uint64_t all = 0;
+    for (uint i = 0; i < MATRIX_GROUP / 8; i++)
+    {
+        all ^= lsb[i];
+        syndrome ^= (i * 8) & -(uint)__builtin_parityll(lsb[i]);
+    }
+    syndrome ^= __builtin_parityll(all & 0x0100010001000100ULL);
+    syndrome ^= __builtin_parityll(all & 0x0101000001010000ULL) << 1;
+    syndrome ^= __builtin_parityll(all & 0x0101010100000000ULL) << 2;
+    return syndrome;
+}
+#endif
+
+/* Syndrome of a block
+ * Inputs: Block of carrier bytes and its size
+ * Output: Positions, counted from 1, of bytes with LSB set are XORed.
+ * Blocks of 63 bytes and more go 8 bytes at a time on little endian
+ * hosts, the rest byte by byte, giving the same syndrome
+ * Return Value: Bits embedded in the block
+ */
+uint matrix_syndrome(const char *block, uint block_size)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (block_size >= MATRIX_GROUP - 1)
+        return matrix_syndrome_words(block, block_size);
+#endif
+    uint syndrome = 0;
+    for (uint i = 0; i < block_size; i++)
+        syndrome ^= (i + 1) & -(uint)(block[i] & 1);
+    return syndrome;
+}
+
+/* Embed bits into a block
+ * Inputs: Block of carrier bytes, its size and bits to embed
+ * Output: The byte at the position given by the difference of the syndrome
+ * and the bits gets its LSB flipped, which makes the syndrome equal to the
+ * bits. No byte changes if they already match
+ * Return Value: Number of bytes changed, 0 or 1
+ */
+uint matrix_embed(char *block, uint block_size, uint message)
+{
+    uint position = matrix_syndrome(block, block_size) ^ message;
+    if (position == 0)
+        return 0;
+    block[position - 1] ^= 1;
+    return 1;
+}
@@ -0,0 +1,47 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include "types.h" // Contains user defined types
+
+/*
+ * Matrix embedding with Hamming codes. The payload after
+ * the header is embedded p bits at a time into blocks of
+ * 2^p - 1 carrier bytes. The p bits are the syndrome of
+ * the block LSBs, the XOR of the 1 based positions of the
+ * bytes whose LSB is set, so embedding flips the LSB of at
+ * most one byte per block and extracting is a single XOR
+ * pass over the block. Larger p changes fewer bytes per
+ * payload bit but needs more carrier bytes
+ *
+ * p = 2   3 byte blocks, 2 bits per 0.75 changes
+ * p = 8   255 byte blocks, 8 bits per 1 change
+ * p = 15  32767 byte blocks, 15 bits per 1 change
+ */
+
+#define MATRIX_FLAG "--matrix"
+#define MATRIX_MIN_BITS 2
+/* Largest block fits the MAX_IMAGE_BUF_SIZE * MAX_SECRET_CHUNK_SIZE job buffer */
+#define MATRIX_MAX_BITS 15
+/* Positions per group of the word wise syndrome */
+#define MATRIX_GROUP 64
+/* Header bytes embedded one bit per byte, magic string, version and code parameter */
+#define MATRIX_HEADER_SIZE 4
+
+/* Matrix embedding function prototype */
+
+/* Bytes in a block of a code */
+uint matrix_block_size(uint bits);
+
+/* Carrier bytes used by a payload of given bytes */
+uint64_t matrix_carrier_bytes(uint bits, uint64_t payload_size);
+
+/* Largest code whose payload fits the capacity, 0 if none does */
+uint matrix_best_bits(uint64_t capacity, uint64_t payload_size);
+
+/* Syndrome of a block */
+uint matrix_syndrome(const char *block, uint block_size);
+
+/* Embed bits into a block, flipping at most one LSB */
+uint matrix_embed(char *block, uint block_size, uint message);
+
+#endif
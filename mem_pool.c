@@ -0,0 +1,265 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mem_pool.h"
+#include "io_engine.h"
+#include "placement.h"
+#include "types.h"
+
+/* Heap allocations made through this file by all threads */
+static uint64_t pool_allocs;
+
+/* Heap calls of the calling thread, malloc, calloc, realloc and mem_alloc_aligned */
+static __thread uint64_t heap_calls_thread;
+
+/* Job arena of each thread, freed on thread exit */
+static pthread_key_t job_arena_key;
+static pthread_once_t job_arena_once = PTHREAD_ONCE_INIT;
+
+/* Block pools shared by all jobs, one per node */
+static BlockPool shared_pools[PLACEMENT_MAX_NODES];
+static pthread_once_t shared_pool_once = PTHREAD_ONCE_INIT;
+
+/* Function Definitions */
+
+/* Aligned heap allocation
+ * Input: Size in bytes
+ * Output: Allocation is counted
+ * Return Value: MEM_ALIGN aligned memory or NULL
+ */
+void *mem_alloc_aligned(size_t size)
+{
+    void *ptr;
+    if (posix_memalign(&ptr, MEM_ALIGN, size) != 0)
+        return NULL;
+    __atomic_fetch_add(&pool_allocs, 1, __ATOMIC_RELAXED);
+    heap_calls_thread++;
+    return ptr;
+}
+
+/* Free memory from mem_alloc_aligned
+ * Input: Pointer, may be NULL
+ */
+void mem_free(void *ptr)
+{
+    free(ptr);
+}
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+/* glibc allocator, which the wrappers below forward to */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+/* Counted malloc
+ * Input: Size in bytes
+ * Output: Replaces malloc of glibc for every caller in the process, libc and
+ * stdio included, and counts the call on the calling thread
+ * Return Value: Memory or NULL
+ */
+void *malloc(size_t size)
+{
+    heap_calls_thread++;
+    return __libc_malloc(size);
+}
+
+/* Counted calloc
+ * Inputs: Number of elements and element size
+ * Return Value: Zeroed memory or NULL
+ */
+void *calloc(size_t nmemb, size_t size)
+{
+    heap_calls_thread++;
+    return __libc_calloc(nmemb, size);
+}
+
+/* Counted realloc
+ * Inputs: Pointer, may be NULL, and new size
+ * Return Value: Memory or NULL
+ */
+void *realloc(void *ptr, size_t size)
+{
+    heap_calls_thread++;
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+/* Heap calls made by the calling thread
+ * Return Value: Count of malloc, calloc, realloc and mem_alloc_aligned calls
+ * on this thread. Without glibc, or under AddressSanitizer which replaces the
+ * allocator itself, only mem_alloc_aligned calls are counted
+ */
+uint64_t mem_heap_calls_thread(void)
+{
+    return heap_calls_thread;
+}
+
+/* Heap allocations made for arenas and block pools
+ * Return Value: Count of mem_alloc_aligned calls and job arena structs in
+ * the process. malloc calls of libc, stdio and other code are not counted
+ */
+uint64_t mem_pool_allocs(void)
+{
+    return __atomic_load_n(&pool_allocs, __ATOMIC_RELAXED);
+}
+
+/* Allocate arena memory
+ * Inputs: arena and size in bytes
+ * Return Value: e_success or e_failure
+ */
+Status arena_init(Arena *arena, size_t size)
+{
+    arena->base = mem_alloc_aligned(size);
+    arena->size = arena->base != NULL ? size : 0;
+    arena->used = 0;
+    return arena->base != NULL ? e_success : e_failure;
+}
+
+/* Take memory from arena
+ * Inputs: arena and size in bytes
+ * Output: Memory is MEM_ARENA_ALIGN aligned
+ * Return Value: Pointer or NULL, if arena is full
+ */
+void *arena_alloc(Arena *arena, size_t size)
+{
+    size_t start = (arena->used + MEM_ARENA_ALIGN - 1) & ~(size_t)(MEM_ARENA_ALIGN - 1);
+    if (start > arena->size || size > arena->size - start)
+        return NULL;
+    arena->used = start + size;
+    return arena->base + start;
+}
+
+/* Release everything taken from the arena
+ * Input: arena
+ */
+void arena_reset(Arena *arena)
+{
+    arena->used = 0;
+}
+
+/* Free arena memory
+ * Input: arena
+ */
+void arena_free(Arena *arena)
+{
+    mem_free(arena->base);
+    arena->base = NULL;
+    arena->size = arena->used = 0;
+}
+
+/* Destructor of job arena key, runs on thread exit */
+static void job_arena_destroy(void *ptr)
+{
+    arena_free(ptr);
+    free(ptr);
+}
+
+/* Creates job arena key once */
+static void job_arena_key_create(void)
+{
+    pthread_key_create(&job_arena_key, job_arena_destroy);
+}
+
+/* Job arena of the calling thread
+ * Output: Arena is created on first use in a thread and reused by every later job
+ * Return Value: Arena or NULL, if it could not be allocated
+ */
+Arena *job_arena(void)
+{
+    pthread_once(&job_arena_once, job_arena_key_create);
+    Arena *arena = pthread_getspecific(job_arena_key);
+    if (arena == NULL)
+    {
+        arena = malloc(sizeof(Arena));
+        if (arena == NULL)
+            return NULL;
+        __atomic_fetch_add(&pool_allocs, 1, __ATOMIC_RELAXED);
+        if (arena_init(arena, MEM_ARENA_SIZE) != e_success)
+        {
+            free(arena);
+            return NULL;
+        }
+        pthread_setspecific(job_arena_key, arena);
+    }
+    return arena;
+}
+
+/* Initialise block pool
+ * Inputs: pool and size of each block
+ * Return Value: e_success or e_failure
+ */
+Status block_pool_init(BlockPool *pool, size_t block_size)
+{
+    memset(pool, 0, sizeof(*pool));
+    pool->block_size = block_size;
+    return pthread_mutex_init(&pool->lock, NULL) == 0 ? e_success : e_failure;
+}
+
+/* Get a block
+ * Input: pool
+ * Output: A free block is reused, a new one is allocated only if none is free
+ * Return Value: MEM_ALIGN aligned block or NULL
+ */
+char *block_pool_get(BlockPool *pool)
+{
+    char *block = NULL;
+    pthread_mutex_lock(&pool->lock);
+    if (pool->num_free > 0)
+        block = pool->free_blocks[--pool->num_free];
+    pthread_mutex_unlock(&pool->lock);
+    if (block == NULL)
+    {
+        block = mem_alloc_aligned(pool->block_size);
+        // first touch by the calling thread places the pages on its node
+        for (size_t i = 0; block != NULL && i < pool->block_size; i += MEM_ALIGN)
+            block[i] = 0;
+    }
+    return block;
+}
+
+/* Give a block back
+ * Inputs: pool and block, may be NULL
+ * Output: Block is kept for reuse, or freed once MEM_POOL_MAX_FREE blocks are kept
+ */
+void block_pool_put(BlockPool *pool, char *block)
+{
+    if (block == NULL)
+        return;
+    pthread_mutex_lock(&pool->lock);
+    if (pool->num_free < MEM_POOL_MAX_FREE)
+    {
+        pool->free_blocks[pool->num_free++] = block;
+        block = NULL;
+    }
+    pthread_mutex_unlock(&pool->lock);
+    mem_free(block);
+}
+
+/* Free blocks kept by the pool
+ * Input: pool
+ */
+void block_pool_destroy(BlockPool *pool)
+{
+    for (uint i = 0; i < pool->num_free; i++)
+        mem_free(pool->free_blocks[i]);
+    pool->num_free = 0;
+    pthread_mutex_destroy(&pool->lock);
+}
+
+/* Creates shared block pools once */
+static void shared_pool_create(void)
+{
+    for (uint i = 0; i < PLACEMENT_MAX_NODES; i++)
+        block_pool_init(&shared_pools[i], IO_BLOCK_SIZE);
+}
+
+/* Block pool shared by all jobs
+ * Output: Jobs on a pinned worker get the pool of its node, so blocks are
+ * reused by threads of the node they were first touched on
+ * Return Value: Pool of IO_BLOCK_SIZE blocks
+ */
+BlockPool *shared_block_pool(void)
+{
+    pthread_once(&shared_pool_once, shared_pool_create);
+    return &shared_pools[placement_current_node()];
+}
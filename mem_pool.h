@@ -0,0 +1,86 @@
+#ifndef MEM_POOL_H
+#define MEM_POOL_H
+
+#include <stddef.h>
+#include <pthread.h>
+#include "types.h" // Contains user defined types
+
+/*
+ * Memory used by encode and decode jobs.
+ * Job arena: bump allocator for per job buffers, one
+ * per thread, reset at the start of every job.
+ * Block pool: large aligned blocks for the I/O engine,
+ * shared by all jobs of a NUMA node and reused.
+ * Heap allocations made here are counted, so a steady
+ * state where jobs reuse arenas and blocks can be checked.
+ * malloc, calloc and realloc of the whole process, libc and
+ * stdio included, are wrapped and counted per thread, so a
+ * job can show it made no heap call on its hot path
+ */
+
+/* Alignment of arena and pool memory, covers 64 byte SIMD loads and direct I/O */
+#define MEM_ALIGN 4096
+#define MEM_ARENA_ALIGN 64
+#define MEM_ARENA_SIZE (1 << 20)
+#define MEM_POOL_MAX_FREE 64
+
+typedef struct _Arena
+{
+    char *base;
+    size_t size;
+    size_t used;
+} Arena;
+
+typedef struct _BlockPool
+{
+    pthread_mutex_t lock;
+    size_t block_size;
+    char *free_blocks[MEM_POOL_MAX_FREE];
+    uint num_free;
+} BlockPool;
+
+/* Memory pool function prototype */
+
+/* Aligned heap allocation, counted */
+void *mem_alloc_aligned(size_t size);
+
+/* Free memory from mem_alloc_aligned */
+void mem_free(void *ptr);
+
+/* Heap calls made by the calling thread */
+uint64_t mem_heap_calls_thread(void);
+
+/* Heap allocations made for arenas and block pools by all threads */
+uint64_t mem_pool_allocs(void);
+
+/* Allocate arena memory */
+Status arena_init(Arena *arena, size_t size);
+
+/* Take size bytes from the arena, NULL if it is full */
+void *arena_alloc(Arena *arena, size_t size);
+
+/* Release everything taken from the arena */
+void arena_reset(Arena *arena);
+
+/* Free arena memory */
+void arena_free(Arena *arena);
+
+/* Job arena of the calling thread */
+Arena *job_arena(void);
+
+/* Initialise block pool */
+Status block_pool_init(BlockPool *pool, size_t block_size);
+
+/* Get a block, reusing a free one if any */
+char *block_pool_get(BlockPool *pool);
+
+/* Give a block back for reuse */
+void block_pool_put(BlockPool *pool, char *block);
+
+/* Free blocks kept by the pool */
+void block_pool_destroy(BlockPool *pool);
+
+/* Block pool shared by all jobs of the calling thread's node, blocks are IO_BLOCK_SIZE bytes */
+BlockPool *shared_block_pool(void);
+
+#endif
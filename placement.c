@@ -0,0 +1,250 @@
+// sched_setaffinity and CPU_SET
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sched.h>
+#include <pthread.h>
+#include "placement.h"
+#include "types.h"
+
+/* Node index of this thread, set when it is pinned as a worker */
+static __thread uint current_node;
+
+/* Function Definitions */
+
+/* Get policy from its name
+ * Inputs: Name, none, node or core, and destination policy
+ * Return Value: e_success or e_failure, if the name is not known
+ */
+Status placement_parse_policy(const char *name, PlacementPolicy *policy)
+{
+    for (PlacementPolicy p = e_place_none; p <= e_place_core; p++)
+    {
+        if (strcmp(name, placement_policy_name(p)) == 0)
+        {
+            *policy = p;
+            return e_success;
+        }
+    }
+    return e_failure;
+}
+
+/* Name of a policy
+ * Input: Policy
+ * Return Value: Name used on the command line
+ */
+const char *placement_policy_name(PlacementPolicy policy)
+{
+    switch (policy)
+    {
+    case e_place_node:
+        return "node";
+    case e_place_core:
+        return "core";
+    default:
+        return "none";
+    }
+}
+
+/* Read a CPU list
+ * Inputs: sysfs path and mask to fill
+ * Output: CPUs of a list like 0-3,8-11 are set in mask
+ * Return Value: e_success or e_failure, if the list can not be read
+ */
+static Status placement_read_cpulist(const char *path, uint64_t *mask)
+{
+    char list[4096];
+    FILE *fptr = fopen(path, "r");
+    if (fptr == NULL)
+        return e_failure;
+    char *ret = fgets(list, sizeof(list), fptr);
+    fclose(fptr);
+    if (ret == NULL)
+        return e_failure;
+    for (char *pos = list; *pos >= '0' && *pos <= '9';)
+    {
+        unsigned long first = strtoul(pos, &pos, 10), last = first;
+        if (*pos == '-')
+            last = strtoul(pos + 1, &pos, 10);
+        for (unsigned long cpu = first; cpu <= last && cpu < PLACEMENT_MAX_CPUS; cpu++)
+            mask[cpu / 64] |= 1ULL << (cpu % 64);
+        if (*pos == ',')
+            pos++;
+    }
+    return e_success;
+}
+
+/* Order CPUs of a node for policy core
+ * Inputs: placement and node index
+ * Output: Rank of a CPU is the number of its SMT siblings of the node with
+ * a lower number, read from thread_siblings_list, 0 where it can not be
+ * read. CPUs of rank 0, one per physical core, come first, then rank 1
+ * and so on
+ */
+static void placement_order_cpus(Placement *placement, uint node)
+{
+    uint8_t rank[PLACEMENT_MAX_CPUS];
+    uint max_rank = 0;
+    for (uint cpu = 0; cpu < PLACEMENT_MAX_CPUS; cpu++)
+    {
+        rank[cpu] = 0;
+        if (!(placement->cpu_mask[node][cpu / 64] >> (cpu % 64) & 1))
+            continue;
+        uint64_t siblings[PLACEMENT_MASK_WORDS] = {0};
+        char path[96];
+        snprintf(path, sizeof(path), PLACEMENT_SYSFS_CPUS "/cpu%u/topology/thread_siblings_list", cpu);
+        if (placement_read_cpulist(path, siblings) != e_success)
+            continue;
+        for (uint other = 0; other < cpu; other++)
+        {
+            if (siblings[other / 64] >> (other % 64) & 1 && placement->cpu_mask[node][other / 64] >> (other % 64) & 1)
+                rank[cpu]++;
+        }
+        if (rank[cpu] > max_rank)
+            max_rank = rank[cpu];
+    }
+    uint count = 0;
+    for (uint r = 0; r <= max_rank; r++)
+    {
+        for (uint cpu = 0; cpu < PLACEMENT_MAX_CPUS; cpu++)
+        {
+            if (placement->cpu_mask[node][cpu / 64] >> (cpu % 64) & 1 && rank[cpu] == r)
+                placement->cpu_order[node][count++] = cpu;
+        }
+    }
+}
+
+/* Order system node numbers */
+static int placement_compare_ids(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+/* Read node topology
+ * Inputs: placement and policy
+ * Output: Nodes with CPUs the process may run on are stored in node order.
+ * Nodes past PLACEMENT_MAX_NODES share a slot with an earlier one. Without
+ * sysfs, or with policy none, all allowed CPUs form one node
+ */
+void placement_init(Placement *placement, PlacementPolicy policy)
+{
+    memset(placement, 0, sizeof(*placement));
+    placement->policy = policy;
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        CPU_ZERO(&allowed);
+
+    int ids[PLACEMENT_MAX_CPUS];
+    uint num_ids = 0;
+    DIR *dir = policy != e_place_none ? opendir(PLACEMENT_SYSFS_NODES) : NULL;
+    if (dir != NULL)
+    {
+        struct dirent *entry;
+        int id;
+        while ((entry = readdir(dir)) != NULL && num_ids < PLACEMENT_MAX_CPUS)
+        {
+            if (sscanf(entry->d_name, "node%d", &id) == 1 && id >= 0)
+                ids[num_ids++] = id;
+        }
+        closedir(dir);
+    }
+    qsort(ids, num_ids, sizeof(int), placement_compare_ids);
+
+    uint found = 0;
+    for (uint i = 0; i < num_ids; i++)
+    {
+        uint64_t mask[PLACEMENT_MASK_WORDS] = {0};
+        char path[64];
+        snprintf(path, sizeof(path), PLACEMENT_SYSFS_NODES "/node%d/cpulist", ids[i]);
+        if (placement_read_cpulist(path, mask) != e_success)
+            continue;
+        uint num_cpus = 0;
+        for (uint cpu = 0; cpu < PLACEMENT_MAX_CPUS && cpu < CPU_SETSIZE; cpu++)
+        {
+            uint64_t bit = 1ULL << (cpu % 64);
+            if (!CPU_ISSET(cpu, &allowed))
+                mask[cpu / 64] &= ~bit;
+            else if (mask[cpu / 64] & bit)
+                num_cpus++;
+        }
+        // memory only nodes and nodes outside the affinity mask get no workers
+        if (num_cpus == 0)
+            continue;
+        uint node = found++ % PLACEMENT_MAX_NODES;
+        if (node == placement->num_nodes)
+            placement->node_ids[placement->num_nodes++] = ids[i];
+        for (uint w = 0; w < PLACEMENT_MASK_WORDS; w++)
+            placement->cpu_mask[node][w] |= mask[w];
+        placement->num_cpus[node] += num_cpus;
+    }
+
+    if (placement->num_nodes == 0)
+    {
+        placement->num_nodes = 1;
+        for (uint cpu = 0; cpu < PLACEMENT_MAX_CPUS && cpu < CPU_SETSIZE; cpu++)
+        {
+            if (CPU_ISSET(cpu, &allowed))
+            {
+                placement->cpu_mask[0][cpu / 64] |= 1ULL << (cpu % 64);
+                placement->num_cpus[0]++;
+            }
+        }
+    }
+    if (policy == e_place_core)
+    {
+        for (uint node = 0; node < placement->num_nodes; node++)
+            placement_order_cpus(placement, node);
+    }
+}
+
+/* Node of a worker
+ * Inputs: placement and worker id
+ * Return Value: Node index, workers are spread round robin
+ */
+uint placement_worker_node(const Placement *placement, uint worker)
+{
+    return worker % placement->num_nodes;
+}
+
+/* Pin a worker
+ * Inputs: placement and worker id of the calling thread
+ * Output: Thread is pinned to the CPUs of its node, or for policy core to
+ * the next CPU of its node, physical cores before their SMT siblings, and
+ * its node index is remembered. Threads it creates later inherit the affinity
+ * Return Value: e_success or e_failure, if the affinity could not be set
+ */
+Status placement_bind_worker(const Placement *placement, uint worker)
+{
+    uint node = placement_worker_node(placement, worker);
+    current_node = node;
+    if (placement->policy == e_place_none || placement->num_cpus[node] == 0)
+        return e_success;
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    if (placement->policy == e_place_core)
+    {
+        // workers of a node take its CPUs in turn, physical cores first
+        uint cpu = placement->cpu_order[node][worker / placement->num_nodes % placement->num_cpus[node]];
+        if (cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &cpus);
+    }
+    for (uint cpu = 0; placement->policy == e_place_node && cpu < PLACEMENT_MAX_CPUS && cpu < CPU_SETSIZE; cpu++)
+    {
+        if (placement->cpu_mask[node][cpu / 64] >> (cpu % 64) & 1)
+            CPU_SET(cpu, &cpus);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0 ? e_success : e_failure;
+}
+
+/* Node of the calling thread
+ * Return Value: Node index the thread was pinned to, 0 for other threads
+ */
+uint placement_current_node(void)
+{
+    return current_node;
+}
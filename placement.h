@@ -0,0 +1,70 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include "types.h" // Contains user defined types
+
+/*
+ * Placement of worker threads on NUMA nodes and cores.
+ * Nodes and their CPUs are read from sysfs, limited to
+ * the CPUs the process may run on. Workers are spread
+ * round robin over the nodes and pinned to the CPUs of
+ * their node, or to one CPU each. For one CPU each, the
+ * workers of a node take one hardware thread of every
+ * physical core before any SMT sibling, so two workers
+ * share a core and its caches only when there are more
+ * workers than cores. A pinned thread
+ * remembers its node, so block buffers it takes come from
+ * the pool of that node and are first touched there
+ */
+
+#define PLACEMENT_MAX_NODES 16
+#define PLACEMENT_MAX_CPUS 1024
+#define PLACEMENT_MASK_WORDS (PLACEMENT_MAX_CPUS / 64)
+#define PLACEMENT_SYSFS_NODES "/sys/devices/system/node"
+#define PLACEMENT_SYSFS_CPUS "/sys/devices/system/cpu"
+
+typedef enum
+{
+    /* Workers are not pinned, one queue for all */
+    e_place_none,
+    /* Workers pinned to the CPUs of their node */
+    e_place_node,
+    /* Workers pinned to one CPU of their node each, physical cores first */
+    e_place_core
+} PlacementPolicy;
+
+typedef struct _Placement
+{
+    PlacementPolicy policy;
+    uint num_nodes;
+
+    /* System node number and allowed CPUs of each node */
+    int node_ids[PLACEMENT_MAX_NODES];
+    uint64_t cpu_mask[PLACEMENT_MAX_NODES][PLACEMENT_MASK_WORDS];
+    uint num_cpus[PLACEMENT_MAX_NODES];
+
+    /* CPUs of each node in the order workers take them for policy core */
+    uint16_t cpu_order[PLACEMENT_MAX_NODES][PLACEMENT_MAX_CPUS];
+} Placement;
+
+/* Placement function prototype */
+
+/* Get policy from its name */
+Status placement_parse_policy(const char *name, PlacementPolicy *policy);
+
+/* Name of a policy */
+const char *placement_policy_name(PlacementPolicy policy);
+
+/* Read node topology for a policy */
+void placement_init(Placement *placement, PlacementPolicy policy);
+
+/* Node index a worker is placed on */
+uint placement_worker_node(const Placement *placement, uint worker);
+
+/* Pin calling thread as a worker and remember its node */
+Status placement_bind_worker(const Placement *placement, uint worker);
+
+/* Node index of the calling thread, 0 if not pinned */
+uint placement_current_node(void);
+
+#endif
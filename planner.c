@@ -0,0 +1,293 @@
+// 64 bit file offsets so multi-GB carriers and payloads work
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "planner.h"
+#include "carrier_cache.h"
+#include "encode.h"
+#include "types.h"
+
+/* Function Definitions */
+
+/* Read and validate plan arguments
+ * Input: Argument count, command line arguments and planInfo
+ * Output: Carrier directory and secret file names are stored in planInfo
+ * Return: e_success or e_failure
+ */
+Status read_and_validate_plan_args(int argc, char *argv[], PlannerInfo *planInfo)
+{
+    struct stat st;
+    memset(planInfo, 0, sizeof(*planInfo));
+    // Checks if 2nd argument passed is a directory
+    if (stat(argv[2], &st) == 0 && S_ISDIR(st.st_mode))
+    {
+        planInfo->carrier_dir = argv[2];
+    }
+    else
+    {
+        printf("INFO : Please mention carrier directory correctly Eg:carriers/\n");
+        return e_failure;
+    }
+    planInfo->num_payloads = argc - 3;
+    planInfo->payloads = calloc(planInfo->num_payloads, sizeof(PlanPayload));
+    if (planInfo->payloads == NULL)
+        return e_failure;
+    // Checks if remaining arguments are .txt , .c or .sh files
+    for (uint i = 0; i < planInfo->num_payloads; i++)
+    {
+        char *extn = strstr(argv[i + 3], ".");
+        if (extn == NULL || (strcmp(extn, ".txt") != 0 && strcmp(extn, ".c") != 0 && strcmp(extn, ".sh") != 0))
+        {
+            printf("INFO : Please mention secret file correctly Eg:secret.txt\n");
+            planner_free(planInfo);
+            return e_failure;
+        }
+        planInfo->payloads[i].secret_fname = argv[i + 3];
+        planInfo->payloads[i].carrier = -1;
+    }
+    return e_success;
+}
+
+/* Order carriers by capacity, then file size */
+static int planner_compare_carriers(const void *a, const void *b)
+{
+    const PlanCarrier *x = a, *y = b;
+    if (x->capacity != y->capacity)
+        return x->capacity < y->capacity ? -1 : 1;
+    if (x->size != y->size)
+        return x->size < y->size ? -1 : 1;
+    return strcmp(x->fname, y->fname);
+}
+
+/* Index carriers
+ * Inputs: planInfo and carrier directory
+ * Output: Every carrier image file of the directory not already stegged is added,
+ * headers come from the carrier cache, carriers are sorted by capacity
+ * Return Value: e_success or e_failure
+ */
+Status planner_index(PlannerInfo *planInfo, const char *carrier_dir)
+{
+    DIR *dir = opendir(carrier_dir);
+    if (dir == NULL)
+    {
+        perror("opendir ");
+        return e_failure;
+    }
+    uint allocated = 0;
+    struct dirent *entry;
+    char path[PLAN_PATH_MAX];
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (carrier_format_by_name(entry->d_name) == NULL)
+            continue;
+        if (snprintf(path, sizeof(path), "%s/%s", carrier_dir, entry->d_name) >= (int)sizeof(path))
+            continue;
+        FILE *fptr = fopen(path, "r");
+        if (fptr == NULL)
+            continue;
+        CarrierInfo carrier;
+        Status status = carrier_cache_get(fptr, &carrier);
+        fclose(fptr);
+        if (status != e_success || carrier.stegged || carrier.capacity == 0)
+            continue;
+        // array grows by doubling
+        if (planInfo->num_carriers == allocated)
+        {
+            uint count = allocated ? allocated * 2 : 64;
+            PlanCarrier *carriers = realloc(planInfo->carriers, count * sizeof(PlanCarrier));
+            if (carriers == NULL)
+            {
+                closedir(dir);
+                return e_failure;
+            }
+            planInfo->carriers = carriers;
+            allocated = count;
+        }
+        PlanCarrier *plan = &planInfo->carriers[planInfo->num_carriers];
+        plan->fname = strdup(path);
+        if (plan->fname == NULL)
+        {
+            closedir(dir);
+            return e_failure;
+        }
+        plan->capacity = carrier.capacity;
+        plan->size = carrier.size;
+        planInfo->num_carriers++;
+    }
+    closedir(dir);
+
+    qsort(planInfo->carriers, planInfo->num_carriers, sizeof(PlanCarrier), planner_compare_carriers);
+    // every carrier is unused, index num_carriers is the end sentinel
+    planInfo->next_unused = malloc((planInfo->num_carriers + 1) * sizeof(uint));
+    if (planInfo->next_unused == NULL)
+        return e_failure;
+    for (uint i = 0; i <= planInfo->num_carriers; i++)
+        planInfo->next_unused[i] = i;
+    return e_success;
+}
+
+/* Smallest fitting carrier
+ * Inputs: planInfo and payload size in bits
+ * Output: Binary search over carriers sorted by capacity
+ * Return Value: Index of the first carrier with capacity greater than
+ * payload bits, as check_capacity needs, or -1 if none is large enough
+ */
+int planner_best_fit(PlannerInfo *planInfo, uint64_t payload_bits)
+{
+    uint low = 0, high = planInfo->num_carriers;
+    while (low < high)
+    {
+        uint mid = low + (high - low) / 2;
+        if (planInfo->carriers[mid].capacity > payload_bits)
+            high = mid;
+        else
+            low = mid + 1;
+    }
+    return low < planInfo->num_carriers ? (int)low : -1;
+}
+
+/* Find next unused carrier
+ * Inputs: next_unused array and start index
+ * Output: Paths are halved on the way
+ * Return Value: Index of the first unused carrier at or after start
+ */
+static uint planner_find_unused(uint *next_unused, uint index)
+{
+    while (next_unused[index] != index)
+    {
+        next_unused[index] = next_unused[next_unused[index]];
+        index = next_unused[index];
+    }
+    return index;
+}
+
+/* Take smallest unused fitting carrier
+ * Inputs: planInfo and payload size in bits
+ * Output: Carrier is marked used by linking it to the next index
+ * Return Value: Index of the carrier or -1 if none is left
+ */
+int planner_take_best_fit(PlannerInfo *planInfo, uint64_t payload_bits)
+{
+    int fit = planner_best_fit(planInfo, payload_bits);
+    if (fit < 0)
+        return -1;
+    uint index = planner_find_unused(planInfo->next_unused, fit);
+    if (index == planInfo->num_carriers)
+        return -1;
+    planInfo->next_unused[index] = index + 1;
+    return index;
+}
+
+/* Order payloads by size, largest first */
+static int planner_compare_payloads(const void *a, const void *b)
+{
+    const PlanPayload *x = *(PlanPayload *const *)a, *y = *(PlanPayload *const *)b;
+    if (x->size != y->size)
+        return x->size > y->size ? -1 : 1;
+    return 0;
+}
+
+/* Plan batch
+ * Input: planInfo with payload sizes set
+ * Output: Carrier of each payload is set, largest payload first, each
+ * taking the smallest unused carrier that fits it
+ * Return Value: e_success or e_failure, if some payload got no carrier
+ */
+Status planner_plan_batch(PlannerInfo *planInfo)
+{
+    PlanPayload **order = malloc(planInfo->num_payloads * sizeof(PlanPayload *));
+    if (order == NULL)
+        return e_failure;
+    for (uint i = 0; i < planInfo->num_payloads; i++)
+        order[i] = &planInfo->payloads[i];
+    qsort(order, planInfo->num_payloads, sizeof(PlanPayload *), planner_compare_payloads);
+
+    Status status = e_success;
+    for (uint i = 0; i < planInfo->num_payloads; i++)
+    {
+        order[i]->carrier = planner_take_best_fit(planInfo, order[i]->size * 8);
+        if (order[i]->carrier < 0)
+            status = e_failure;
+    }
+    free(order);
+    return status;
+}
+
+/* Do planning
+ * Input: planInfo
+ * Output: Carriers are indexed, payload sizes are read and the plan is
+ * printed with the carrier bytes it takes
+ * Return Value: e_success or e_failure
+ */
+Status do_planning(PlannerInfo *planInfo)
+{
+    if (planner_index(planInfo, planInfo->carrier_dir) == e_success)
+    {
+        printf("INFO : Indexed %u carriers from %s\n", planInfo->num_carriers, planInfo->carrier_dir);
+    }
+    else
+    {
+        printf("ERROR : Indexing carriers failed\n");
+        planner_free(planInfo);
+        return e_failure;
+    }
+    for (uint i = 0; i < planInfo->num_payloads; i++)
+    {
+        PlanPayload *payload = &planInfo->payloads[i];
+        struct stat st;
+        if (stat(payload->secret_fname, &st) != 0)
+        {
+            perror("stat ");
+            printf("ERROR : Unable to open file %s\n", payload->secret_fname);
+            planner_free(planInfo);
+            return e_failure;
+        }
+        // payload size includes magic string, version and sizes
+        payload->size = get_payload_size(strstr(payload->secret_fname, "."), st.st_size);
+    }
+
+    Status status = planner_plan_batch(planInfo);
+    uint64_t planned_bytes = 0;
+    for (uint i = 0; i < planInfo->num_payloads; i++)
+    {
+        PlanPayload *payload = &planInfo->payloads[i];
+        if (payload->carrier < 0)
+        {
+            printf("ERROR : No unused carrier fits %s (%llu bytes)\n", payload->secret_fname, (unsigned long long)payload->size);
+            continue;
+        }
+        PlanCarrier *carrier = &planInfo->carriers[payload->carrier];
+        printf("INFO : Plan %s -> %s, %llu of %llu capacity bytes\n", payload->secret_fname, carrier->fname,
+               (unsigned long long)payload->size * 8, (unsigned long long)carrier->capacity);
+        planned_bytes += carrier->size;
+    }
+    if (planInfo->num_carriers > 0)
+    {
+        // compared to using the largest carrier for every payload
+        uint64_t largest = planInfo->carriers[planInfo->num_carriers - 1].size;
+        printf("INFO : Planned carriers take %llu bytes, largest carrier for every payload %llu bytes\n",
+               (unsigned long long)planned_bytes, (unsigned long long)largest * planInfo->num_payloads);
+    }
+    planner_free(planInfo);
+    return status;
+}
+
+/* Free planner memory
+ * Input: planInfo
+ */
+void planner_free(PlannerInfo *planInfo)
+{
+    for (uint i = 0; i < planInfo->num_carriers; i++)
+        free(planInfo->carriers[i].fname);
+    free(planInfo->carriers);
+    free(planInfo->next_unused);
+    free(planInfo->payloads);
+    planInfo->carriers = NULL;
+    planInfo->next_unused = NULL;
+    planInfo->payloads = NULL;
+    planInfo->num_carriers = planInfo->num_payloads = 0;
+}
@@ -0,0 +1,74 @@
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include "types.h" // Contains user defined types
+
+/*
+ * Carrier planner. A directory of carriers is indexed
+ * by capacity in a sorted array, the smallest carrier
+ * fitting a payload is found by binary search. A batch
+ * of payloads is planned best fit decreasing: largest
+ * payload first, each taking the smallest unused
+ * carrier that fits it. Carriers are used at most once,
+ * two stego images of the same cover would give the
+ * payload away by a simple diff
+ */
+
+#define PLAN_PATH_MAX 4096
+
+/* Indexed carrier */
+typedef struct _PlanCarrier
+{
+    char *fname;
+    uint64_t capacity;
+    uint64_t size;
+} PlanCarrier;
+
+/* Payload to place */
+typedef struct _PlanPayload
+{
+    char *secret_fname;
+    /* Bytes embedded, header fields and data */
+    uint64_t size;
+    int carrier;
+} PlanPayload;
+
+typedef struct _PlannerInfo
+{
+    /* Carriers sorted by capacity */
+    char *carrier_dir;
+    PlanCarrier *carriers;
+    uint num_carriers;
+
+    /* Next unused carrier at or after each index, union-find with path halving */
+    uint *next_unused;
+
+    /* Payloads of the batch */
+    PlanPayload *payloads;
+    uint num_payloads;
+} PlannerInfo;
+
+/* Planner function prototype */
+
+/* Read and validate plan args from argv */
+Status read_and_validate_plan_args(int argc, char *argv[], PlannerInfo *planInfo);
+
+/* Index carriers and plan the batch */
+Status do_planning(PlannerInfo *planInfo);
+
+/* Index carriers of a directory by capacity */
+Status planner_index(PlannerInfo *planInfo, const char *carrier_dir);
+
+/* Smallest carrier fitting payload bits, -1 if none */
+int planner_best_fit(PlannerInfo *planInfo, uint64_t payload_bits);
+
+/* Take smallest unused carrier fitting payload bits, -1 if none */
+int planner_take_best_fit(PlannerInfo *planInfo, uint64_t payload_bits);
+
+/* Plan batch best fit decreasing */
+Status planner_plan_batch(PlannerInfo *planInfo);
+
+/* Free planner memory */
+void planner_free(PlannerInfo *planInfo);
+
+#endif
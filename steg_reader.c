@@ -0,0 +1,192 @@
+// 64 bit file offsets so multi-GB carriers and payloads work
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "steg_reader.h"
+#include "encode.h"
+#include "carrier_cache.h"
+#include "types.h"
+#include "common.h"
+
+/* Function Definitions */
+
+/* Set up payload of stego reader
+ * Inputs: reader, parsed carrier, secret file pointer and secret file extension
+ * Output: Payload prefix is serialized and the payload region is computed
+ * Return Value: e_success or e_failure, if the secret does not fit the carrier
+ */
+static Status steg_reader_setup(StegReader *reader, const CarrierInfo *carrier, FILE *fptr_secret, const char *extn)
+{
+    uint extn_len = strlen(extn);
+    if (extn_len >= MAX_FILE_SUFFIX)
+    {
+        printf("ERROR : Secret file extension %s is too long\n", extn);
+        return e_failure;
+    }
+    reader->fd_secret = fileno(fptr_secret);
+    reader->carrier_size = carrier->size;
+    reader->secret_size = get_file_size(fptr_secret);
+
+    // same bytes as the encoder embeds before the secret data
+    uint len = 0;
+    memcpy(reader->prefix, MAGIC_STRING, strlen(MAGIC_STRING));
+    len += strlen(MAGIC_STRING);
+    reader->prefix[len++] = STEGO_VERSION;
+    len += encode_varint(extn_len, reader->prefix + len);
+    memcpy(reader->prefix + len, extn, extn_len);
+    len += extn_len;
+    len += encode_varint(reader->secret_size, reader->prefix + len);
+    reader->prefix_len = len;
+
+    uint64_t payload_bits = get_payload_size(extn, reader->secret_size) * 8;
+    reader->payload_start = carrier->pixel_offset;
+    reader->payload_end = reader->payload_start + payload_bits;
+    reader->position = 0;
+    if (carrier->capacity <= payload_bits || reader->payload_end > reader->carrier_size)
+    {
+        printf("ERROR : Check capacity failed\n");
+        return e_failure;
+    }
+    return e_success;
+}
+
+/* Set up stego reader
+ * Inputs: reader, carrier image and secret file pointers and secret file extension
+ * Output: Payload prefix is serialized and the payload region is computed,
+ * the files are only read with pread afterwards and are not closed by the reader
+ * Return Value: e_success or e_failure, if the secret does not fit the carrier
+ */
+Status steg_reader_open(StegReader *reader, FILE *fptr_carrier, FILE *fptr_secret, const char *extn)
+{
+    CarrierInfo carrier;
+    if (carrier_cache_get(fptr_carrier, &carrier) != e_success)
+        return e_failure;
+    reader->fd_carrier = fileno(fptr_carrier);
+    return steg_reader_setup(reader, &carrier, fptr_secret, extn);
+}
+
+/* Set up stego reader for a synthesized carrier
+ * Inputs: reader, carrier built by carrier_synthesize, its seed, secret
+ * file pointer and secret file extension
+ * Output: As steg_reader_open, carrier bytes are generated by
+ * carrier_synth_fill instead of read
+ * Return Value: e_success or e_failure, if the secret does not fit the carrier
+ */
+Status steg_reader_open_synthetic(StegReader *reader, const CarrierInfo *carrier, uint64_t seed, FILE *fptr_secret, const char *extn)
+{
+    reader->fd_carrier = -1;
+    reader->synth = *carrier;
+    reader->synth_seed = seed;
+    return steg_reader_setup(reader, carrier, fptr_secret, extn);
+}
+
+/* Get payload bytes
+ * Inputs: reader, destination buffer, index of first payload byte and count
+ * Output: Prefix bytes are copied and secret bytes are read from the secret file
+ * Return Value: e_success or e_failure
+ */
+static Status steg_reader_payload(StegReader *reader, char *buffer, uint64_t index, uint64_t count)
+{
+    // bytes of the serialized prefix
+    while (count > 0 && index < reader->prefix_len)
+    {
+        *buffer++ = reader->prefix[index++];
+        count--;
+    }
+    // bytes of the secret file
+    uint64_t secret_offset = index - reader->prefix_len;
+    while (count > 0)
+    {
+        ssize_t ret = pread(reader->fd_secret, buffer, count, secret_offset);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return e_failure;
+        buffer += ret;
+        secret_offset += ret;
+        count -= ret;
+    }
+    return e_success;
+}
+
+/* Read stego bytes at offset
+ * Inputs: reader, destination buffer, size and offset in the stego image
+ * Output: Carrier bytes are read, or generated for a synthesized carrier, and
+ * the ones in the payload region get the payload bits in their LSB, MSB
+ * first, as encode_byte_to_lsb does
+ * Return Value: Bytes read, 0 at end of image or -1 on error
+ */
+ssize_t steg_reader_pread(StegReader *reader, char *buffer, size_t size, uint64_t offset)
+{
+    if (offset >= reader->carrier_size)
+        return 0;
+    if (size > reader->carrier_size - offset)
+        size = reader->carrier_size - offset;
+
+    // header and tail pass through unchanged, a synthesized carrier is generated
+    size_t done = 0;
+    if (reader->fd_carrier < 0)
+    {
+        carrier_synth_fill(&reader->synth, reader->synth_seed, buffer, size, offset);
+        done = size;
+    }
+    while (done < size)
+    {
+        ssize_t ret = pread(reader->fd_carrier, buffer + done, size - done, offset + done);
+        if (ret < 0 && errno == EINTR)
+            continue;
+        if (ret <= 0)
+            return -1;
+        done += ret;
+    }
+
+    // part of the range inside the payload region
+    uint64_t start = offset > reader->payload_start ? offset : reader->payload_start;
+    uint64_t end = offset + size < reader->payload_end ? offset + size : reader->payload_end;
+    char payload[STEG_READER_CHUNK_SIZE];
+    while (start < end)
+    {
+        // payload bytes needed by this chunk of carrier bytes
+        uint64_t first = (start - reader->payload_start) / 8;
+        uint64_t last = (end - 1 - reader->payload_start) / 8;
+        uint64_t count = last - first + 1 < STEG_READER_CHUNK_SIZE ? last - first + 1 : STEG_READER_CHUNK_SIZE;
+        if (steg_reader_payload(reader, payload, first, count) != e_success)
+            return -1;
+        uint64_t stop = reader->payload_start + (first + count) * 8;
+        if (stop > end)
+            stop = end;
+        for (uint64_t i = start; i < stop; i++)
+        {
+            uint64_t bit = i - reader->payload_start;
+            char data = payload[bit / 8 - first];
+            buffer[i - offset] = (buffer[i - offset] & 0xFE) | ((data >> (7 - bit % 8)) & 1);
+        }
+        start = stop;
+    }
+    return size;
+}
+
+/* Read next stego bytes
+ * Inputs: reader, destination buffer and size
+ * Output: Reads from the reader position, which is advanced
+ * Return Value: Bytes read, 0 at end of image or -1 on error
+ */
+ssize_t steg_reader_read(StegReader *reader, char *buffer, size_t size)
+{
+    ssize_t ret = steg_reader_pread(reader, buffer, size, reader->position);
+    if (ret > 0)
+        reader->position += ret;
+    return ret;
+}
+
+/* Size of the stego image
+ * Input: reader
+ * Return Value: Size in bytes, same as the carrier
+ */
+uint64_t steg_reader_size(StegReader *reader)
+{
+    return reader->carrier_size;
+}
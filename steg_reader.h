@@ -0,0 +1,65 @@
+#ifndef STEG_READER_H
+#define STEG_READER_H
+
+#include <stdio.h>
+#include <sys/types.h>
+#include "types.h" // Contains user defined types
+#include "common.h"
+#include "carrier.h"
+
+/*
+ * Pull based reader producing the stego image on demand
+ * from the carrier and secret files, without writing it
+ * out. Bytes are the image header, the payload region with
+ * patched LSBs and the untouched tail, in constant memory.
+ * Random access with steg_reader_pread lets a server
+ * answer range requests directly. The carrier may be a
+ * synthesized one, whose bytes are generated instead of read
+ */
+
+#define STEG_READER_CHUNK_SIZE 4096
+/* Magic string, version, extn size, extn and secret size */
+#define STEG_READER_MAX_PREFIX (sizeof(MAGIC_STRING) + 1 + MAX_VARINT_SIZE + 8 + MAX_VARINT_SIZE)
+
+typedef struct _StegReader
+{
+    /* Carrier and secret files, read with pread, no carrier file if synthesized */
+    int fd_carrier;
+    int fd_secret;
+    uint64_t carrier_size;
+    uint64_t secret_size;
+
+    /* Payload bytes before the secret data */
+    char prefix[STEG_READER_MAX_PREFIX];
+    uint prefix_len;
+
+    /* Carrier offsets where the payload region starts and ends */
+    uint64_t payload_start;
+    uint64_t payload_end;
+
+    /* Offset of next steg_reader_read */
+    uint64_t position;
+
+    /* Synthesized carrier and its seed */
+    CarrierInfo synth;
+    uint64_t synth_seed;
+} StegReader;
+
+/* Stego reader function prototype */
+
+/* Set up reader for carrier and secret with given extension */
+Status steg_reader_open(StegReader *reader, FILE *fptr_carrier, FILE *fptr_secret, const char *extn);
+
+/* Set up reader for a synthesized carrier and secret with given extension */
+Status steg_reader_open_synthetic(StegReader *reader, const CarrierInfo *carrier, uint64_t seed, FILE *fptr_secret, const char *extn);
+
+/* Read stego bytes at offset, returns bytes read, 0 at end or -1 on error */
+ssize_t steg_reader_pread(StegReader *reader, char *buffer, size_t size, uint64_t offset);
+
+/* Read next stego bytes, returns bytes read, 0 at end or -1 on error */
+ssize_t steg_reader_read(StegReader *reader, char *buffer, size_t size);
+
+/* Size of the stego image */
+uint64_t steg_reader_size(StegReader *reader);
+
+#endif
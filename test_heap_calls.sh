@@ -0,0 +1,75 @@
+#!/bin/bash
+# Heap calls of embedding and extracting on a warm daemon worker
+#
+# Usage         :   ./test_heap_calls.sh <work directory (optional, default a new one in $TMPDIR)>
+# Description   :   A daemon with one worker encodes beautiful.bmp with secret.txt
+#                   and decodes it to a file and inline, each job twice. After every
+#                   job the hot_heap_calls count of STATS is read: the heap calls
+#                   (malloc, calloc, realloc, counted per thread by the wrappers in
+#                   mem_pool.c) made while embedding or extracting. The second job
+#                   of each kind runs on the warm worker and must add none.
+#                   Needs python3 to pass descriptors over the socket
+set -e -o pipefail
+
+repo=$(cd "$(dirname "$0")" && pwd)
+work=${1:-$(mktemp -d "${TMPDIR:-/tmp}/stego-heap.XXXXXX")}
+mkdir -p "$work"
+trap 'kill $daemon 2>/dev/null; rm -f "$work/a.out" "$work/d.sock" "$work/stego.bmp" "$work/decoded.txt" "$work/daemon.log"; rmdir "$work" 2>/dev/null' EXIT
+
+gcc -O2 "$repo"/*.c -pthread -lm -o "$work/a.out"
+"$work/a.out" -D "$work/d.sock" 1 > "$work/daemon.log" 2>&1 &
+daemon=$!
+for i in $(seq 50); do
+    [ -S "$work/d.sock" ] && break
+    sleep 0.1
+done
+
+python3 - "$repo" "$work" <<'EOF'
+import array, os, re, socket, sys
+repo, work = sys.argv[1], sys.argv[2]
+
+def request(line, fds=()):
+    conn = socket.socket(socket.AF_UNIX)
+    conn.connect(os.path.join(work, "d.sock"))
+    ancillary = [(socket.SOL_SOCKET, socket.SCM_RIGHTS, array.array("i", fds))] if fds else []
+    conn.sendmsg([line.encode() + b"\n"], ancillary)
+    reply = b""
+    while True:
+        data = conn.recv(1 << 16)
+        if not data:
+            break
+        reply += data
+    conn.close()
+    for fd in fds:
+        os.close(fd)
+    return reply
+
+def hot_heap_calls():
+    return int(re.search(rb"hot_heap_calls=(\d+)", request("STATS")).group(1))
+
+def encode():
+    return request("ENCODE .txt", [os.open(os.path.join(repo, "beautiful.bmp"), os.O_RDONLY),
+                                   os.open(os.path.join(repo, "secret.txt"), os.O_RDONLY),
+                                   os.open(os.path.join(work, "stego.bmp"), os.O_WRONLY | os.O_CREAT | os.O_TRUNC, 0o644)])
+
+def decode():
+    return request("DECODE", [os.open(os.path.join(work, "stego.bmp"), os.O_RDONLY),
+                              os.open(os.path.join(work, "decoded.txt"), os.O_WRONLY | os.O_CREAT | os.O_TRUNC, 0o644)])
+
+def decode_inline():
+    return request("DECODE", [os.open(os.path.join(work, "stego.bmp"), os.O_RDONLY)])
+
+failed = False
+for name, job in (("embedding", encode), ("extracting", decode), ("extracting inline", decode_inline)):
+    counts = []
+    for i in range(2):
+        reply = job()
+        if not reply.startswith(b"OK"):
+            sys.exit("FAIL : %s job replied %r" % (name, reply))
+        counts.append(hot_heap_calls())
+    delta = counts[1] - counts[0]
+    print("%s : second job made %d heap calls while %s" % ("PASS" if delta == 0 else "FAIL", delta, name))
+    failed = failed or delta != 0
+sys.exit(1 if failed else 0)
+EOF
+cmp "$repo/secret.txt" "$work/decoded.txt"
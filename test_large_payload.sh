@@ -0,0 +1,42 @@
+#!/bin/bash
+# Round trip of a payload past the 32 bit limits of the old header
+#
+# Usage         :   ./test_large_payload.sh <work directory (optional, default a new one in $TMPDIR)>
+#                   SIZE_MB sets the secret size in MB, default 600
+# Description   :   A 65536x65536 24 bit BMP carrier (12 GB of pixel data) is made
+#                   sparse with truncate, which calls ftruncate, so it takes no disk
+#                   space. A random secret of 600 MB is embedded and decoded back
+#                   and compared. Its size needs a 5 byte (35 bit) varint and its
+#                   bits span 4.9 GB of carrier, so sizes and offsets above 32 bits
+#                   are used. The carrier holds 1.5 GB at most, so a secret of 4 GB
+#                   or more does not fit any BMP of this size.
+#                   The stego image is written in full, about 12 GB of free disk
+#                   space is needed
+set -e -o pipefail
+
+repo=$(cd "$(dirname "$0")" && pwd)
+work=${1:-$(mktemp -d "${TMPDIR:-/tmp}/stego-large.XXXXXX")}
+size_mb=${SIZE_MB:-600}
+mkdir -p "$work"
+trap 'rm -f "$work/carrier.bmp" "$work/secret.txt" "$work/stego.bmp" "$work/decoded.txt" "$work/a.out"' EXIT
+
+gcc -O2 "$repo"/*.c -pthread -lm -o "$work/a.out"
+
+# BITMAPFILEHEADER, file size field keeps its low 32 bits, pixel data at 54
+# BITMAPINFOHEADER, 65536x65536, 1 plane, 24 bits, no compression
+printf 'BM\x36\x00\x00\x00\x00\x00\x00\x00\x36\x00\x00\x00' > "$work/carrier.bmp"
+printf '\x28\x00\x00\x00\x00\x00\x01\x00\x00\x00\x01\x00\x01\x00\x18\x00' >> "$work/carrier.bmp"
+printf '\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00' >> "$work/carrier.bmp"
+truncate -s $((54 + 65536 * 65536 * 3)) "$work/carrier.bmp"
+
+head -c $((size_mb * 1024 * 1024)) /dev/urandom > "$work/secret.txt"
+
+"$work/a.out" -e "$work/carrier.bmp" "$work/secret.txt" "$work/stego.bmp" --fsync=none | grep -E "ERROR|Encoding|complete"
+"$work/a.out" -d "$work/stego.bmp" "$work/decoded.txt" --fsync=none | grep -E "ERROR|Decoding completed|complete"
+
+if cmp "$work/secret.txt" "$work/decoded.txt"; then
+    echo "PASS : $size_mb MB secret decoded from a 65536x65536 carrier"
+else
+    echo "FAIL : decoded secret differs"
+    exit 1
+fi
@@ -1,6 +1,8 @@
 #ifndef TYPES_H
 #define TYPES_H
 
+#include <stdint.h>
+
 /* User defined types */
 typedef unsigned int uint;
 
@@ -15,6 +17,10 @@ typedef enum
 {
     e_encode,
     e_decode,
+    e_daemon,
+    e_analyze,
+    e_plan,
+    e_compare,
     e_unsupported
 } OperationType;
 
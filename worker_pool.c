@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "worker_pool.h"
+#include "types.h"
+
+/* Argument of each worker thread */
+typedef struct _WorkerArg
+{
+    WorkerPool *pool;
+    uint id;
+} WorkerArg;
+
+/* Function Definitions */
+
+/* Monotonic time in nanoseconds
+ * Return Value: Nanoseconds from CLOCK_MONOTONIC
+ */
+uint64_t worker_pool_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Queue to steal from
+ * Input: pool, with lock held
+ * Return Value: Queue of the node with the most pending work, NULL if all are empty
+ */
+static WorkQueue *worker_pool_steal_queue(WorkerPool *pool)
+{
+    WorkQueue *victim = NULL;
+    for (uint i = 0; i < pool->placement.num_nodes; i++)
+    {
+        if (pool->queues[i].count > 0 && (victim == NULL || pool->queues[i].count > victim->count))
+            victim = &pool->queues[i];
+    }
+    return victim;
+}
+
+/* Worker thread
+ * Input: WorkerArg of this worker
+ * Output: Worker is pinned by the placement policy, then runs queued work
+ * of its node, or stolen from other nodes when its own queue is empty, till
+ * the pool is stopped and all queues are empty
+ */
+static void *worker_main(void *arg)
+{
+    WorkerArg *worker = arg;
+    WorkerPool *pool = worker->pool;
+    uint node = placement_worker_node(&pool->placement, worker->id);
+    WorkQueue *own = &pool->queues[node];
+    // pinned before the worker touches any buffer, so its buffers are allocated on its node
+    if (placement_bind_worker(&pool->placement, worker->id) != e_success)
+        printf("INFO : Pinning worker %u failed, it runs unpinned\n", worker->id);
+    pthread_mutex_lock(&pool->lock);
+    while (1)
+    {
+        WorkQueue *queue = own;
+        while (queue->count == 0)
+        {
+            queue = worker_pool_steal_queue(pool);
+            if (queue != NULL || pool->stop)
+                break;
+            own->idle++;
+            pthread_cond_wait(&own->not_empty, &pool->lock);
+            own->idle--;
+            queue = own;
+        }
+        if (queue == NULL)
+            break;
+        // takes oldest item from the queue
+        WorkItem item = queue->items[queue->head];
+        queue->head = (queue->head + 1) % WORK_QUEUE_SIZE;
+        queue->count--;
+        pool->count--;
+        pool->active++;
+        if (queue != own)
+            pool->stats.nodes[node].jobs_stolen++;
+        pthread_cond_signal(&pool->not_full);
+        pthread_mutex_unlock(&pool->lock);
+
+        uint64_t start_ns = worker_pool_now_ns();
+        item.function(item.arg, item.data, worker->id);
+        uint64_t end_ns = worker_pool_now_ns();
+
+        pthread_mutex_lock(&pool->lock);
+        pool->active--;
+        pool->stats.jobs_done++;
+        pool->stats.nodes[node].jobs_done++;
+        pool->stats.nodes[node].busy_ns += end_ns - start_ns;
+        pool->stats.wait_ns_total += start_ns - item.queued_ns;
+        pool->stats.latency_ns_total += end_ns - item.queued_ns;
+        if (end_ns - item.queued_ns > pool->stats.latency_ns_max)
+            pool->stats.latency_ns_max = end_ns - item.queued_ns;
+        if (pool->count == 0 && pool->active == 0)
+            pthread_cond_broadcast(&pool->idle);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/* Start worker threads
+ * Inputs: pool, number of workers and placement policy
+ * Output: Node topology is read, worker threads are created, spread over
+ * the nodes, and wait for work. With fewer workers than nodes only the
+ * first nodes are used
+ * Return Value: e_success or e_failure
+ */
+Status worker_pool_start(WorkerPool *pool, uint num_workers, PlacementPolicy policy)
+{
+    memset(pool, 0, sizeof(*pool));
+    if (num_workers == 0)
+        return e_failure;
+    placement_init(&pool->placement, policy);
+    if (pool->placement.num_nodes > num_workers)
+        pool->placement.num_nodes = num_workers;
+    pool->threads = calloc(num_workers, sizeof(pthread_t));
+    pool->worker_args = calloc(num_workers, sizeof(WorkerArg));
+    pool->queues = calloc(pool->placement.num_nodes, sizeof(WorkQueue));
+    if (pool->threads == NULL || pool->worker_args == NULL || pool->queues == NULL)
+    {
+        free(pool->threads);
+        free(pool->worker_args);
+        free(pool->queues);
+        return e_failure;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->not_full, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+    pool->stats.num_workers = num_workers;
+    pool->stats.policy = policy;
+    pool->stats.num_nodes = pool->placement.num_nodes;
+    for (uint i = 0; i < pool->placement.num_nodes; i++)
+    {
+        pthread_cond_init(&pool->queues[i].not_empty, NULL);
+        pool->stats.nodes[i].node_id = pool->placement.node_ids[i];
+    }
+    for (uint i = 0; i < num_workers; i++)
+    {
+        uint node = placement_worker_node(&pool->placement, i);
+        pool->queues[node].num_workers++;
+        pool->stats.nodes[node].num_workers++;
+    }
+    for (uint i = 0; i < num_workers; i++)
+    {
+        pool->worker_args[i].pool = pool;
+        pool->worker_args[i].id = i;
+        if (pthread_create(&pool->threads[i], NULL, worker_main, &pool->worker_args[i]) != 0)
+        {
+            // stops the workers already running
+            pool->num_workers = i;
+            worker_pool_stop(pool);
+            return e_failure;
+        }
+    }
+    pool->num_workers = num_workers;
+    return e_success;
+}
+
+/* Pick node for new work
+ * Input: pool, with lock held
+ * Return Value: Index of a node with more idle workers than queued work,
+ * searched round robin, else of the node with the least queued work per worker
+ */
+static uint worker_pool_pick_node(WorkerPool *pool)
+{
+    uint num_nodes = pool->placement.num_nodes, best = pool->next_node % num_nodes;
+    for (uint n = 0; n < num_nodes; n++)
+    {
+        uint i = (pool->next_node + n) % num_nodes;
+        WorkQueue *queue = &pool->queues[i], *least = &pool->queues[best];
+        if (queue->idle > queue->count)
+        {
+            best = i;
+            break;
+        }
+        // compared without division, count / workers < least count / least workers
+        if ((uint64_t)queue->count * least->num_workers < (uint64_t)least->count * queue->num_workers)
+            best = i;
+    }
+    pool->next_node = (best + 1) % num_nodes;
+    return best;
+}
+
+/* Queue work
+ * Inputs: pool, work function with its arg and data, and wait flag
+ * Output: Work is queued for the next free worker
+ * Return Value: e_success or e_failure, if queue is full and wait is not set
+ */
+Status worker_pool_submit(WorkerPool *pool, WorkFunction function, void *arg, long data, int wait)
+{
+    pthread_mutex_lock(&pool->lock);
+    while (pool->count == WORK_QUEUE_SIZE)
+    {
+        if (!wait)
+        {
+            pthread_mutex_unlock(&pool->lock);
+            return e_failure;
+        }
+        pthread_cond_wait(&pool->not_full, &pool->lock);
+    }
+    WorkQueue *queue = &pool->queues[worker_pool_pick_node(pool)];
+    WorkItem *item = &queue->items[(queue->head + queue->count) % WORK_QUEUE_SIZE];
+    item->function = function;
+    item->arg = arg;
+    item->data = data;
+    item->queued_ns = worker_pool_now_ns();
+    queue->count++;
+    pool->count++;
+    if (pool->count > pool->stats.max_queued)
+        pool->stats.max_queued = pool->count;
+    if (queue->idle > 0)
+        pthread_cond_signal(&queue->not_empty);
+    // workers of the node are all busy, an idle worker of another node steals it
+    if (queue->idle < queue->count)
+    {
+        for (uint i = 0; i < pool->placement.num_nodes; i++)
+        {
+            if (pool->queues[i].idle > pool->queues[i].count)
+            {
+                pthread_cond_signal(&pool->queues[i].not_empty);
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return e_success;
+}
+
+/* Wait till pool is idle
+ * Input: pool
+ * Output: Returns once queue is empty and no worker is busy
+ */
+void worker_pool_wait_idle(WorkerPool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    while (pool->count > 0 || pool->active > 0)
+        pthread_cond_wait(&pool->idle, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* Add bytes processed
+ * Inputs: pool, id of the worker and bytes of its current job
+ * Output: Bytes are added to the node of the worker, for its throughput
+ */
+void worker_pool_add_bytes(WorkerPool *pool, uint worker, uint64_t bytes)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->stats.nodes[placement_worker_node(&pool->placement, worker)].bytes += bytes;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* Copy current stats
+ * Inputs: pool and destination stats
+ */
+void worker_pool_get_stats(WorkerPool *pool, WorkerPoolStats *stats)
+{
+    pthread_mutex_lock(&pool->lock);
+    *stats = pool->stats;
+    stats->queued = pool->count;
+    stats->active = pool->active;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/* Stop worker pool
+ * Input: pool
+ * Output: Queued work is finished, threads are joined and resources released
+ */
+void worker_pool_stop(WorkerPool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = 1;
+    for (uint i = 0; i < pool->placement.num_nodes; i++)
+        pthread_cond_broadcast(&pool->queues[i].not_empty);
+    pthread_mutex_unlock(&pool->lock);
+    for (uint i = 0; i < pool->num_workers; i++)
+        pthread_join(pool->threads[i], NULL);
+    pthread_cond_destroy(&pool->idle);
+    pthread_cond_destroy(&pool->not_full);
+    for (uint i = 0; i < pool->placement.num_nodes; i++)
+        pthread_cond_destroy(&pool->queues[i].not_empty);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->threads);
+    free(pool->worker_args);
+    free(pool->queues);
+    pool->threads = NULL;
+    pool->worker_args = NULL;
+    pool->queues = NULL;
+    pool->num_workers = 0;
+}
@@ -0,0 +1,114 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <pthread.h>
+#include "types.h" // Contains user defined types
+#include "placement.h"
+
+/*
+ * Fixed pool of worker threads fed from bounded queues,
+ * one per NUMA node of the placement. Work is queued on
+ * the node with an idle worker or the least work per
+ * worker. A worker takes work of its own node and steals
+ * from other nodes only when its own queue is empty.
+ * When the queues are full either the submitter blocks
+ * or it is reported back, so callers can apply
+ * back-pressure. Queue depth and latency stats are kept
+ * per pool, jobs, steals and throughput per node
+ */
+
+#define WORK_QUEUE_SIZE 256
+
+/* Work function, gets submitted arg and data and the id of the worker running it */
+typedef void (*WorkFunction)(void *arg, long data, uint worker);
+
+typedef struct _WorkItem
+{
+    WorkFunction function;
+    void *arg;
+    long data;
+    uint64_t queued_ns;
+} WorkItem;
+
+typedef struct _WorkerNodeStats
+{
+    int node_id;
+    uint num_workers;
+    uint64_t jobs_done;
+    uint64_t jobs_stolen;
+    uint64_t busy_ns;
+    uint64_t bytes;
+} WorkerNodeStats;
+
+typedef struct _WorkerPoolStats
+{
+    uint num_workers;
+    uint queued;
+    uint max_queued;
+    uint active;
+    uint64_t jobs_done;
+    uint64_t wait_ns_total;
+    uint64_t latency_ns_total;
+    uint64_t latency_ns_max;
+    PlacementPolicy policy;
+    uint num_nodes;
+    WorkerNodeStats nodes[PLACEMENT_MAX_NODES];
+} WorkerPoolStats;
+
+/* Bounded queue of pending work of one node */
+typedef struct _WorkQueue
+{
+    WorkItem items[WORK_QUEUE_SIZE];
+    uint head;
+    uint count;
+    /* Workers of the node waiting for work */
+    uint idle;
+    uint num_workers;
+    pthread_cond_t not_empty;
+} WorkQueue;
+
+typedef struct _WorkerPool
+{
+    uint num_workers;
+    pthread_t *threads;
+    struct _WorkerArg *worker_args;
+    Placement placement;
+
+    /* Queues of pending work, one per node, count is the total */
+    WorkQueue *queues;
+    uint count;
+    uint next_node;
+    uint active;
+    int stop;
+    pthread_mutex_t lock;
+    pthread_cond_t not_full;
+    pthread_cond_t idle;
+
+    /* Stats */
+    WorkerPoolStats stats;
+} WorkerPool;
+
+/* Worker pool function prototype */
+
+/* Start worker threads placed by policy */
+Status worker_pool_start(WorkerPool *pool, uint num_workers, PlacementPolicy policy);
+
+/* Queue work, waits for room if wait is set else fails on a full queue */
+Status worker_pool_submit(WorkerPool *pool, WorkFunction function, void *arg, long data, int wait);
+
+/* Wait till queue is empty and no worker is busy */
+void worker_pool_wait_idle(WorkerPool *pool);
+
+/* Add bytes processed by the current job of a worker */
+void worker_pool_add_bytes(WorkerPool *pool, uint worker, uint64_t bytes);
+
+/* Copy current stats */
+void worker_pool_get_stats(WorkerPool *pool, WorkerPoolStats *stats);
+
+/* Finish queued work and stop worker threads */
+void worker_pool_stop(WorkerPool *pool);
+
+/* Monotonic time in nanoseconds */
+uint64_t worker_pool_now_ns(void);
+
+#endif